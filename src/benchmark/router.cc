@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Compare api-call lookup cost of the router against a linear scan.
+  */
+
+ #include <config.h>
+ #include <private/router.h>
+ #include <chrono>
+ #include <cstring>
+ #include <iostream>
+ #include <iomanip>
+ #include <list>
+ #include <random>
+ #include <string>
+ #include <vector>
+
+ using namespace std;
+ using namespace Udjat;
+
+ /// @brief Minimal api-call, matches by path prefix like RequestPath.
+ struct Call {
+
+	string text;
+
+	Call(size_t id) : text{"/api/v1/resource" + to_string(id) + "/items"} {
+	}
+
+	inline const char * path() const noexcept {
+		return text.c_str();
+	}
+
+	inline bool operator==(const char *request) const noexcept {
+		return strncmp(request,text.c_str(),text.size()) == 0;
+	}
+
+ };
+
+ static volatile size_t found = 0;
+
+ template <typename Lookup>
+ static double measure(const vector<string> &requests, size_t iterations, const Lookup &lookup) {
+
+	auto start = chrono::steady_clock::now();
+	for(size_t ix = 0; ix < iterations; ix++) {
+		if(lookup(requests[ix % requests.size()].c_str())) {
+			found = found + 1;
+		}
+	}
+	auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+
+	return ((double) elapsed.count()) / iterations;
+
+ }
+
+ int main(int, char **) {
+
+	static const size_t iterations = 200000;
+
+	cout	<< setw(8) << "calls"
+			<< setw(16) << "linear (ns)"
+			<< setw(16) << "router (ns)"
+			<< endl;
+
+	for(size_t count : { 10, 100, 1000, 10000 }) {
+
+		list<Call> calls;
+		SQL::Router<Call> router;
+
+		for(size_t id = 0; id < count; id++) {
+			calls.emplace_back(id);
+			router.push_back(calls.back());
+		}
+
+		// Requests for random existing calls, with arguments after the path.
+		vector<string> requests;
+		mt19937 random{42};
+		uniform_int_distribution<size_t> distribution{0,count-1};
+		for(size_t ix = 0; ix < 1024; ix++) {
+			requests.push_back(string{"/api/v1/resource"} + to_string(distribution(random)) + "/items/12");
+		}
+
+		double linear = measure(requests, iterations, [&calls](const char *request) -> const Call * {
+			for(const auto &call : calls) {
+				if(call == request) {
+					return &call;
+				}
+			}
+			return nullptr;
+		});
+
+		double indexed = measure(requests, iterations, [&router](const char *request) {
+			return router.find(request,[request](const Call &call){
+				return call == request;
+			});
+		});
+
+		cout	<< setw(8) << count
+				<< setw(16) << fixed << setprecision(1) << linear
+				<< setw(16) << fixed << setprecision(1) << indexed
+				<< endl;
+
+	}
+
+	return 0;
+
+ }
@@ -0,0 +1,499 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Measure throughput and latency of the SQL execution paths.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/request.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/report.h>
+ #include <udjat/tools/protocol.h>
+ #include <udjat/tools/sql/script.h>
+ #include <udjat/alert/sql.h>
+ #include <udjat/alert/activation.h>
+ #include <private/cache.h>
+ #include <private/urlqueue.h>
+ #include <algorithm>
+ #include <atomic>
+ #include <chrono>
+ #include <cstdio>
+ #include <cstdlib>
+ #include <functional>
+ #include <iomanip>
+ #include <iostream>
+ #include <memory>
+ #include <string>
+ #include <thread>
+ #include <vector>
+ #include <cstring>
+ #include <cerrno>
+ #include <stdexcept>
+ #include <sys/socket.h>
+ #include <netinet/in.h>
+ #include <arpa/inet.h>
+ #include <unistd.h>
+
+ using namespace std;
+ using namespace Udjat;
+
+ #define DATABASE "/tmp/udjat-benchmark.sqlite"
+
+ /// @brief Rows on the generated dataset.
+ static const size_t dataset_rows = 1000;
+
+ /// @brief Expose the alert activations.
+ class BenchmarkAlert : public SQL::Alert {
+ public:
+	BenchmarkAlert(const XML::Node &node) : SQL::Alert{node} {
+	}
+
+	using SQL::Alert::ActivationFactory;
+
+ };
+
+ /// @brief Table response discarding the cells, measures the engine side of the table path.
+ class NullTable : public Udjat::Response::Table {
+ public:
+	Udjat::Response::Table & push_back(const char *, Udjat::Value::Type) override {
+		return *this;
+	}
+
+ };
+
+ /// @brief Local HTTP endpoint answering every request with an empty 200, the target of the url queues.
+ class Endpoint {
+ private:
+	int sock = -1;
+	unsigned short port = 0;
+	std::atomic<bool> enabled{true};
+	std::thread listener;
+
+	/// @brief Read the request (headers and body) and answer it.
+	static void answer(int conn) {
+
+		string request;
+		char buffer[4096];
+		size_t expected = string::npos;
+
+		while(request.size() < expected) {
+
+			ssize_t bytes = recv(conn,buffer,sizeof(buffer),0);
+			if(bytes <= 0) {
+				break;
+			}
+			request.append(buffer,bytes);
+
+			size_t headers = request.find("\r\n\r\n");
+			if(expected == string::npos && headers != string::npos) {
+				size_t length = 0;
+				const char *field = strcasestr(request.c_str(),"\r\nContent-Length:");
+				if(field && field < request.c_str() + headers) {
+					length = strtoul(field+17,nullptr,10);
+				}
+				expected = headers + 4 + length;
+			}
+
+		}
+
+		static const char *response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		if(send(conn,response,strlen(response),MSG_NOSIGNAL) < 0) {
+			cerr << "Unable to answer queued request: " << strerror(errno) << endl;
+		}
+		close(conn);
+
+	}
+
+ public:
+	Endpoint() {
+
+		sock = socket(AF_INET,SOCK_STREAM,0);
+
+		sockaddr_in address;
+		memset(&address,0,sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		socklen_t length = sizeof(address);
+		if(sock < 0 || bind(sock,(sockaddr *) &address,sizeof(address)) || listen(sock,128) || getsockname(sock,(sockaddr *) &address,&length)) {
+			throw runtime_error(string{"Unable to start the benchmark endpoint: "} + strerror(errno));
+		}
+		port = ntohs(address.sin_port);
+
+		// One thread for each connection, the queue senders post concurrently.
+		listener = thread{[this](){
+			while(enabled) {
+				int conn = accept(sock,nullptr,nullptr);
+				if(conn < 0) {
+					continue;
+				}
+				thread{answer,conn}.detach();
+			}
+		}};
+
+	}
+
+	~Endpoint() {
+		enabled = false;
+		shutdown(sock,SHUT_RDWR);
+		close(sock);
+		listener.join();
+	}
+
+	string url() const {
+		return string{"http://127.0.0.1:"} + std::to_string(port) + "/benchmark";
+	}
+
+ };
+
+ /// @brief Build an url queue definition on the 'queue' table.
+ /// @param name The queue name, also the tag name.
+ /// @param attributes The queue attributes (senders, insert buffer).
+ static string queue(const char *name, const char *attributes) {
+
+	return
+		string{"<"} + name + " name='" + name + "' url-queue-name='benchmark-" + name + "' update-timer='0' " + attributes + ">"
+		"<refresh>select count (*) as value from queue</refresh>"
+		"<insert>insert into queue (url,action,payload) values (${url},${action},${payload})</insert>"
+		"<send result-set='rows' max-rows='50'>select id, url, action, payload from queue order by id limit 50</send>"
+		"<after-send>delete from queue where id=${id}</after-send>"
+		"</" + name + ">";
+
+ }
+
+ /// @brief Build the benchmark XML definitions.
+ static string definitions() {
+
+	return
+		"<config"
+#ifdef HAVE_SQLITE3
+		" database-connection='" DATABASE "'"
+#else
+		" database-connection='sqlite3:db=" DATABASE "'"
+#endif // HAVE_SQLITE3
+		">"
+		"<init>"
+		"create table if not exists bench (id integer primary key, name text, payload text);"
+		"create table if not exists queue (id integer primary key, url text, action text, payload text);"
+		"delete from bench; delete from queue"
+		"</init>"
+		"<fill>insert into bench (id,name,payload) values (${id},${name},${payload})</fill>"
+		"<select-row name='select-row'>select id, name, payload from bench where id = ${id}</select-row>"
+		"<select-table>select id, name, payload from bench limit 100</select-table>"
+		"<insert>insert into bench (name,payload) values (${name},${payload})</insert>"
+		"<alert name='benchmark'>insert into bench (name,payload) values ('alert','benchmark')</alert>"
+		"<queue-insert>insert into queue (url,action,payload) values (${url},${action},${payload})</queue-insert>"
+		"<queue-send>select id, url, action, payload from queue order by id limit 1</queue-send>"
+		"<queue-after-send>delete from queue where id=${id}</queue-after-send>"
+		"<queue-purge>delete from queue</queue-purge>"
+		"<queue-count>select count (*) as value from queue</queue-count>"
+		+ queue("direct","senders='1'")
+		+ queue("buffered","senders='1' insert-buffer-size='64' insert-buffer-delay='2' insert-durability='commit'")
+		+ queue("drain-1","senders='1'")
+		+ queue("drain-4","senders='4'")
+		+ queue("drain-8","senders='8'")
+		+ "</config>";
+
+ }
+
+ struct Result {
+	double ops;
+	double p50;
+	double p99;
+ };
+
+ /// @brief Run operation on threads for some time.
+ static Result run(size_t threads, double seconds, const std::function<void(size_t thread, size_t iteration)> &operation) {
+
+	vector<vector<double>> latencies(threads);
+	vector<thread> workers;
+
+	auto deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+	auto start = chrono::steady_clock::now();
+
+	for(size_t id = 0; id < threads; id++) {
+		workers.emplace_back([id,deadline,&latencies,&operation](){
+			auto &samples = latencies[id];
+			for(size_t iteration = 0; chrono::steady_clock::now() < deadline; iteration++) {
+				auto from = chrono::steady_clock::now();
+				try {
+					operation(id,iteration);
+				} catch(const std::exception &e) {
+					cerr << e.what() << endl;
+					return;
+				}
+				samples.push_back(chrono::duration<double,micro>(chrono::steady_clock::now() - from).count());
+			}
+		});
+	}
+
+	for(auto &worker : workers) {
+		worker.join();
+	}
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	vector<double> samples;
+	for(auto &thread : latencies) {
+		samples.insert(samples.end(),thread.begin(),thread.end());
+	}
+
+	if(samples.empty()) {
+		return Result{0,0,0};
+	}
+
+	sort(samples.begin(),samples.end());
+
+	return Result{
+		samples.size() / elapsed,
+		samples[samples.size() / 2],
+		samples[min(samples.size()-1,(size_t) (samples.size() * 0.99))]
+	};
+
+ }
+
+ int main(int argc, char **argv) {
+
+	double seconds = (argc > 1 ? atof(argv[1]) : 1.0);
+
+	remove(DATABASE);
+
+	pugi::xml_document document;
+	document.load_string(definitions().c_str());
+	XML::Node root = document.child("config");
+
+	SQL::Script::init(root);
+
+	const SQL::Script fill{root.child("fill")};
+	const SQL::Script select_row{root.child("select-row")};
+	const SQL::Script select_table{root.child("select-table")};
+	const SQL::Script insert{root.child("insert")};
+	const SQL::Script queue_insert{root.child("queue-insert")};
+	const SQL::Script queue_send{root.child("queue-send")};
+	const SQL::Script queue_after_send{root.child("queue-after-send")};
+	const SQL::Script queue_purge{root.child("queue-purge")};
+	const SQL::Script queue_count{root.child("queue-count")};
+	const Udjat::Object object{root.child("select-row")};
+	BenchmarkAlert alert{root.child("alert")};
+
+	SQL::URLQueue direct{root.child("direct")};
+	SQL::URLQueue buffered{root.child("buffered")};
+
+	Endpoint endpoint;
+	const string url = endpoint.url();
+
+	struct Scenario {
+		const char *name;
+		std::function<void(size_t thread, size_t iteration)> operation;
+
+		/// @brief Called after each run, nullptr if not required.
+		std::function<void()> reset = nullptr;
+	};
+
+	string payload;
+
+	// Queue request through the url queue protocol worker, as the alerts do.
+	auto enqueue = [&url,&payload](const SQL::URLQueue &target) {
+		auto worker = target.WorkerFactory();
+		worker->url(url.c_str());
+		worker->payload(payload.c_str());
+		worker->get([](double, double){
+			return true;
+		});
+	};
+
+	auto purge = [&queue_purge]() {
+		queue_purge.exec();
+	};
+
+	vector<Scenario> scenarios = {
+		{
+			"value-object",
+			[&](size_t, size_t iteration) {
+				auto response = Udjat::Value::ObjectFactory();
+				(*response)["id"] = (int) ((iteration % dataset_rows) + 1);
+				select_row.exec(object,*response);
+			}
+		},
+		{
+			"value-shared",
+			[&](size_t, size_t iteration) {
+				auto response = Udjat::Value::ObjectFactory();
+				(*response)["id"] = (int) ((iteration % dataset_rows) + 1);
+				select_row.exec(response);
+			}
+		},
+		{
+			// Query capture used by the api-call cache.
+			"rows",
+			[&](size_t, size_t) {
+				Request request{"/benchmark"};
+				SQL::Rows rows;
+				select_table.exec(request,rows);
+			}
+		},
+		{
+			"table",
+			[&](size_t, size_t) {
+				Request request{"/benchmark"};
+				NullTable table;
+				select_table.exec(request,table);
+			}
+		},
+		{
+			"insert",
+			[&](size_t, size_t) {
+				auto values = Udjat::Value::ObjectFactory();
+				(*values)["name"] = "insert";
+				(*values)["payload"] = payload;
+				insert.exec(values);
+			}
+		},
+		{
+			"alert",
+			[&](size_t, size_t) {
+				alert.ActivationFactory()->emit();
+			}
+		},
+		{
+			// Raw insert/select/delete scripts shaped like the url queue, not the SQL::URLQueue agent.
+			"queue-sql",
+			[&](size_t, size_t) {
+				auto values = Udjat::Value::ObjectFactory();
+				(*values)["url"] = "http://localhost/benchmark";
+				(*values)["action"] = "post";
+				(*values)["payload"] = payload;
+				queue_insert.exec(values);
+
+				auto response = Udjat::Value::ObjectFactory();
+				queue_send.exec(response);
+				if(response->contains("id")) {
+					queue_after_send.exec(response);
+				}
+			}
+		},
+		{
+			// SQL::URLQueue insert, one transaction for each request.
+			"urlqueue",
+			[&](size_t, size_t) {
+				enqueue(direct);
+			},
+			purge
+		},
+		{
+			// SQL::URLQueue insert through the group commit buffer, acknowledged after the commit.
+			"urlqueue-buffer",
+			[&](size_t, size_t) {
+				enqueue(buffered);
+			},
+			purge
+		},
+	};
+
+	cout	<< left << setw(16) << "scenario"
+			<< right << setw(10) << "row-size"
+			<< setw(10) << "threads"
+			<< setw(14) << "ops/s"
+			<< setw(12) << "p50 (us)"
+			<< setw(12) << "p99 (us)"
+			<< endl;
+
+	for(size_t row_size : { 64, 1024, 16384 }) {
+
+		payload.assign(row_size,'x');
+
+		// Generate dataset.
+		for(size_t id = 1; id <= dataset_rows; id++) {
+			auto values = Udjat::Value::ObjectFactory();
+			(*values)["id"] = (int) id;
+			(*values)["name"] = (string{"row"} + std::to_string(id));
+			(*values)["payload"] = payload;
+			fill.exec(values);
+		}
+
+		for(const auto &scenario : scenarios) {
+			for(size_t threads : { 1, 4, 8 }) {
+
+				Result result = run(threads,seconds,scenario.operation);
+
+				if(scenario.reset) {
+					scenario.reset();
+				}
+
+				cout	<< left << setw(16) << scenario.name
+						<< right << setw(10) << row_size
+						<< setw(10) << threads
+						<< setw(14) << fixed << setprecision(0) << result.ops
+						<< setw(12) << fixed << setprecision(1) << result.p50
+						<< setw(12) << fixed << setprecision(1) << result.p99
+						<< endl;
+
+			}
+		}
+
+		// SQL::URLQueue drain, rows sent to the local endpoint per second; the threads are the queue senders.
+		for(const char *name : { "drain-1", "drain-4", "drain-8" }) {
+
+			SQL::URLQueue queue{root.child(name)};
+
+			for(size_t id = 1; id <= dataset_rows; id++) {
+				auto values = Udjat::Value::ObjectFactory();
+				(*values)["url"] = url;
+				(*values)["action"] = "post";
+				(*values)["payload"] = payload;
+				queue_insert.exec(values);
+			}
+
+			auto start = chrono::steady_clock::now();
+			auto deadline = start + chrono::seconds(60);
+			queue.refresh(true);
+
+			unsigned int pending = dataset_rows;
+			while(pending && chrono::steady_clock::now() < deadline) {
+				this_thread::sleep_for(chrono::milliseconds(1));
+				auto response = Udjat::Value::ObjectFactory();
+				queue_count.exec(response);
+				(*response)["value"].get(pending);
+			}
+
+			double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			purge();
+
+			cout	<< left << setw(16) << "urlqueue-drain"
+					<< right << setw(10) << row_size
+					<< setw(10) << root.child(name).attribute("senders").as_uint()
+					<< setw(14) << fixed << setprecision(0) << ((dataset_rows - pending) / elapsed)
+					<< setw(12) << "-"
+					<< setw(12) << "-"
+					<< endl;
+
+		}
+
+		// Reset dataset for the next row size.
+		SQL::Script::init(root);
+
+	}
+
+	return 0;
+
+ }
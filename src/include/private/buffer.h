@@ -0,0 +1,309 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+ /**
+  * @brief Declares the group commit buffer.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/string.h>
+ #include <udjat/tools/logger.h>
+ #include <mutex>
+ #include <condition_variable>
+ #include <vector>
+ #include <thread>
+ #include <chrono>
+ #include <functional>
+ #include <stdexcept>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Bounded buffer, flushing the queued items from a background thread in groups.
+		/// @tparam T The item type.
+		template <typename T>
+		class UDJAT_PRIVATE Buffer {
+		public:
+
+			/// @brief What to do when the buffer is full.
+			enum Overflow : uint8_t {
+				Wait,		///< @brief Block the caller until there's room on the buffer.
+				Reject,		///< @brief Throw an exception on the caller.
+				Drop,		///< @brief Discard the item.
+			};
+
+		private:
+
+			/// @brief Buffer name, for logging.
+			const char *name;
+
+			/// @brief Flush a group of items.
+			const std::function<void(std::vector<T> &items)> method;
+
+			mutable std::mutex guard;
+
+			/// @brief Signaled when an item is queued or the buffer is stopping.
+			std::condition_variable queued;
+
+			/// @brief Signaled when the items leave the buffer.
+			std::condition_variable flushed;
+
+			std::vector<T> items;
+
+			/// @brief Time of the first item on buffer.
+			std::chrono::steady_clock::time_point oldest;
+
+			std::thread thread;
+
+			bool enabled = true;
+
+			struct {
+				/// @brief Items triggering a flush.
+				size_t size = 64;
+
+				/// @brief Milliseconds to wait for more items before flushing.
+				unsigned int delay = 100;
+
+				/// @brief Maximum number of buffered items.
+				size_t max = 1024;
+
+				Overflow overflow = Wait;
+			} limits;
+
+			struct {
+				unsigned long flushes = 0;
+				unsigned long items = 0;
+				unsigned long dropped = 0;
+
+				/// @brief Duration of the last flush, in milliseconds.
+				unsigned int last = 0;
+
+				/// @brief Duration of the slowest flush, in milliseconds.
+				unsigned int max = 0;
+			} statistics;
+
+			void worker() {
+
+				std::unique_lock<std::mutex> lock(guard);
+
+				while(enabled || !items.empty()) {
+
+					if(items.empty()) {
+						queued.wait(lock);
+						continue;
+					}
+
+					if(enabled && items.size() < limits.size) {
+						// Wait for more items, up to the oldest one deadline.
+						queued.wait_until(lock,oldest + std::chrono::milliseconds(limits.delay),[this]{
+							return !enabled || items.size() >= limits.size;
+						});
+					}
+
+					std::vector<T> group;
+					group.swap(items);
+					flushed.notify_all();
+
+					lock.unlock();
+
+					auto started = std::chrono::steady_clock::now();
+					try {
+						method(group);
+					} catch(const std::exception &e) {
+						Logger::String{"Error flushing ",group.size()," item(s): ",e.what()}.error(name);
+					}
+					unsigned int elapsed = (unsigned int) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+
+					lock.lock();
+
+					statistics.flushes++;
+					statistics.items += group.size();
+					statistics.last = elapsed;
+					if(elapsed > statistics.max) {
+						statistics.max = elapsed;
+					}
+
+				}
+
+			}
+
+		public:
+
+			/// @brief Create buffer.
+			/// @param name The buffer name, for logging.
+			/// @param method Flush a group of items, called from the buffer thread.
+			Buffer(const char *n, const std::function<void(std::vector<T> &items)> &m) : name{n}, method{m} {
+			}
+
+			~Buffer() {
+				stop();
+			}
+
+			/// @brief Load limits from XML and enable the buffer.
+			/// @param group The configuration group.
+			/// @param prefix The attribute prefix ('prefix-size', 'prefix-delay', 'prefix-max', 'prefix-overflow').
+			void setup(const XML::Node &node, const char *group, const char *prefix) {
+
+				std::string attr{prefix};
+
+				size_t size = Object::getAttribute(node, group, (attr + "-size").c_str(), (unsigned int) limits.size);
+				unsigned int delay = Object::getAttribute(node, group, (attr + "-delay").c_str(), limits.delay);
+				size_t max = Object::getAttribute(node, group, (attr + "-max").c_str(), (unsigned int) limits.max);
+
+				if(!size) {
+					throw std::runtime_error(Logger::String{"The ",name," buffer requires at least one item per flush"});
+				}
+
+				if(max < size) {
+					throw std::runtime_error(Logger::String{"Invalid ",name," buffer size, the maximum (",max,") is below the flush size (",size,")"});
+				}
+
+				Overflow overflow = limits.overflow;
+				const char *value = Object::getAttribute(node, group, (attr + "-overflow").c_str(), "");
+				if(value && *value) {
+					switch(String{value}.select("wait","reject","drop",nullptr)) {
+					case 0:
+						overflow = Wait;
+						break;
+
+					case 1:
+						overflow = Reject;
+						break;
+
+					case 2:
+						overflow = Drop;
+						break;
+
+					default:
+						throw std::runtime_error(Logger::String{"Invalid ",attr.c_str(),"-overflow '",value,"', expecting wait, reject or drop"});
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(guard);
+				limits.size = size;
+				limits.delay = delay;
+				limits.max = max;
+				limits.overflow = overflow;
+
+				// Accept items again after a stop (module reload), the thread restarts on the next push.
+				enabled = true;
+
+				flushed.notify_all();
+
+			}
+
+			/// @brief Get the overflow policy.
+			Overflow overflow() const noexcept {
+				std::lock_guard<std::mutex> lock(guard);
+				return limits.overflow;
+			}
+
+			/// @brief Queue item, apply the overflow policy if the buffer is full.
+			/// @return false if the item was dropped.
+			bool push(T item) {
+
+				std::unique_lock<std::mutex> lock(guard);
+
+				if(enabled && items.size() >= limits.max) {
+
+					switch(limits.overflow) {
+					case Drop:
+						statistics.dropped++;
+						return false;
+
+					case Reject:
+						throw std::runtime_error(Logger::String{"The ",name," buffer is full"});
+
+					default:
+						flushed.wait(lock,[this]{
+							return !enabled || items.size() < limits.max;
+						});
+					}
+
+				}
+
+				if(!enabled) {
+					throw std::runtime_error(Logger::String{"The ",name," buffer is stopped"});
+				}
+
+				if(items.empty()) {
+					oldest = std::chrono::steady_clock::now();
+				}
+				items.push_back(std::move(item));
+
+				// The thread starts on the first item.
+				if(!thread.joinable()) {
+					thread = std::thread{&Buffer::worker,this};
+				}
+
+				queued.notify_one();
+				return true;
+
+			}
+
+			/// @brief Stop the buffer thread after flushing the queued items.
+			/// @note The buffer rejects new items until the next setup().
+			void stop() {
+
+				{
+					std::lock_guard<std::mutex> lock(guard);
+					enabled = false;
+				}
+
+				queued.notify_all();
+				flushed.notify_all();
+
+				if(thread.joinable()) {
+					thread.join();
+				}
+
+			}
+
+			/// @brief Get buffer state and counters.
+			Udjat::Value & getProperties(Udjat::Value &properties) const {
+
+				std::lock_guard<std::mutex> lock(guard);
+
+				properties["depth"] = (unsigned int) items.size();
+				properties["flush-size"] = (unsigned int) limits.size;
+				properties["flush-delay"] = limits.delay;
+				properties["max-items"] = (unsigned int) limits.max;
+				properties["flushes"] = (unsigned int) statistics.flushes;
+				properties["flushed"] = (unsigned int) statistics.items;
+				properties["dropped"] = (unsigned int) statistics.dropped;
+				properties["last-flush-time"] = statistics.last;
+				properties["max-flush-time"] = statistics.max;
+
+				return properties;
+			}
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the api-call result cache.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/report.h>
+ #include <private/parameter.h>
+ #include <mutex>
+ #include <list>
+ #include <memory>
+ #include <string>
+ #include <vector>
+ #include <unordered_map>
+ #include <ctime>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Get the database generation, changes whenever a write is detected.
+		/// @param dburl The database connection string (interned).
+		UDJAT_PRIVATE unsigned long long generation(const char *dburl);
+
+		/// @brief Rows captured from a query, to be replayed on a table response.
+		class UDJAT_PRIVATE Rows {
+		private:
+			std::vector<std::string> columns;
+			std::vector<Parameter> cells;
+			size_t rows = 0;
+			bool counted = false;
+
+		public:
+
+			void start(const std::vector<std::string> &names);
+
+			Rows & push_back(int value);
+			Rows & push_back(double value);
+			Rows & push_back(const char *value);
+
+			inline Rows & operator<<(const std::string &value) {
+				return push_back(value.c_str());
+			}
+
+			inline void count(size_t value) noexcept {
+				rows = value;
+				counted = true;
+			}
+
+			/// @brief Approximate memory used by the captured rows.
+			size_t size() const noexcept;
+
+			/// @brief Send captured rows to the table.
+			void replay(Udjat::Response::Table &response) const;
+
+		};
+
+		/// @brief Result cache for read-only api-calls.
+		class UDJAT_PRIVATE Cache {
+		private:
+
+			struct Entry {
+				std::string key;
+				time_t expires;
+				unsigned long long generation;
+				size_t size;
+				std::shared_ptr<Udjat::Value> value;
+				std::shared_ptr<Rows> rows;
+			};
+
+			std::mutex guard;
+
+			/// @brief Cached entries, the most recently used first.
+			std::list<Entry> entries;
+
+			/// @brief Entries indexed by key.
+			std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+			/// @brief Memory used by the cached entries.
+			size_t used = 0;
+
+			struct {
+				/// @brief Seconds to keep an entry.
+				time_t ttl = 0;
+
+				/// @brief Maximum number of entries.
+				size_t entries = 256;
+
+				/// @brief Maximum memory for the cached responses.
+				size_t size = 1048576;
+			} limits;
+
+			/// @brief Find valid entry, drop it if expired or stale.
+			const Entry * find(const std::string &key, unsigned long long generation);
+
+			void store(Entry &&entry);
+
+		public:
+
+			Cache(const XML::Node &node);
+
+			/// @brief True if the cache is enabled.
+			inline operator bool() const noexcept {
+				return limits.ttl > 0;
+			}
+
+			/// @brief Get cached value.
+			/// @return false on cache miss.
+			bool get(const std::string &key, unsigned long long generation, Udjat::Value &response);
+
+			/// @brief Get cached table.
+			/// @return false on cache miss.
+			bool get(const std::string &key, unsigned long long generation, Udjat::Response::Table &response);
+
+			/// @brief Store value.
+			/// @param generation The database generation before the query.
+			void put(const std::string &key, unsigned long long generation, const Udjat::Value &response);
+
+			/// @brief Store rows.
+			/// @param generation The database generation before the query.
+			void put(const std::string &key, unsigned long long generation, std::shared_ptr<Rows> rows);
+
+		};
+
+	}
+
+ }
@@ -29,16 +29,76 @@
  #include <udjat/tools/value.h>
  #include <udjat/tools/abstract/object.h>
  #include <cppdb/frontend.h>
+ #include <private/parameter.h>
+ #include <private/statistics.h>
  #include <mutex>
 
  namespace Udjat {
 
 	namespace SQL {
 
+		/// @brief Bind parameter with its native type.
+		void bind(cppdb::statement &stmt, const Parameter &parameter);
+
 		void bind(const SQL::Statement &script, cppdb::statement &stmt, const Abstract::Object &request, Udjat::Value &response);
-		void exec(cppdb::session &session, const std::vector<SQL::Statement> &scripts, const Abstract::Object &request, Udjat::Value &response);
+		void exec(cppdb::session &session, const SQL::Script &script, const Abstract::Object &request, Udjat::Value &response);
+
+		/// @brief Get columns of the current row.
+		void get(cppdb::result &res, Udjat::Value &response);
+
+		/// @brief Get the first row, if available.
 		void parse_result(cppdb::result &res, Udjat::Value &response);
 
+		/// @brief Get select results, all rows when the script has a result set.
+		void fetch(cppdb::statement &stmt, const SQL::Script &script, Udjat::Value &response, Statistics::Probe &probe);
+
+		/// @brief Get query plans for the slow query log.
+		class UDJAT_PRIVATE QueryPlan : public Statistics::Explainer {
+		private:
+			cppdb::session &session;
+
+		public:
+			QueryPlan(cppdb::session &s) : session{s} {
+			}
+
+			std::string explain(const char *text) override;
+
+		};
+
+		/// @brief Signal a database change, invalidates cached responses.
+		/// @param dburl The database connection string (interned).
+		void changed(const char *dburl);
+
+		/// @brief Script transaction, rollback if not commited.
+		class UDJAT_PRIVATE Transaction {
+		private:
+			cppdb::session &session;
+
+			/// @brief The database connection string (interned).
+			const char *dburl;
+
+			/// @brief True if the statements can't change the database.
+			bool readonly;
+
+			/// @brief True after 'BEGIN'.
+			bool active = false;
+
+		public:
+
+			/// @brief Begin transaction.
+			/// @param mode The transaction mode, 'immediate' and 'exclusive' are sqlite3 only, other drivers just begin.
+			Transaction(cppdb::session &session, const char *dburl, SQL::Script::Transaction mode, bool readonly = false);
+
+			/// @brief Begin transaction with the script mode.
+			Transaction(cppdb::session &session, const SQL::Script &script);
+
+			~Transaction();
+
+			/// @brief Commit transaction, signal change if the statements can write.
+			void commit();
+
+		};
+
 	}
 
  }
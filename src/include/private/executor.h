@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the per database executor.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <mutex>
+ #include <condition_variable>
+ #include <deque>
+ #include <vector>
+ #include <thread>
+ #include <atomic>
+ #include <functional>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Bounded task queue running the asynchronous scripts of a single database.
+		class UDJAT_PRIVATE Executor {
+		public:
+
+			/// @brief What to do when the queue is full.
+			enum Overflow : uint8_t {
+				Wait,		///< @brief Block the caller until there's room on the queue.
+				Reject,		///< @brief Throw an exception on the caller.
+				Caller,		///< @brief Run the task on the caller thread.
+			};
+
+		private:
+
+			/// @brief The database name (interned).
+			const char *dbname;
+
+			mutable std::mutex guard;
+
+			/// @brief Signaled when a task is queued or the executor is stopping.
+			std::condition_variable queued;
+
+			/// @brief Signaled when a task leaves the queue.
+			std::condition_variable dequeued;
+
+			std::deque<std::function<void()>> tasks;
+
+			std::vector<std::thread> threads;
+
+			bool enabled = true;
+
+			/// @brief Number of threads running a task.
+			size_t busy = 0;
+
+			struct {
+				/// @brief Maximum number of threads.
+				size_t threads = 1;
+
+				/// @brief Maximum number of queued tasks.
+				size_t queue = 64;
+
+				Overflow overflow = Wait;
+			} limits;
+
+			struct {
+				std::atomic<unsigned long> completed{0};
+				std::atomic<unsigned long> rejected{0};
+				std::atomic<unsigned long> inline_runs{0};
+			} statistics;
+
+			void worker();
+
+			/// @brief Stop threads after running the queued tasks.
+			void stop();
+
+		public:
+
+			Executor(const char *dbname);
+			~Executor();
+
+			/// @brief Get the executor for the database.
+			/// @param dbname The database name, should be a quark.
+			static Executor & getInstance(const char *dbname);
+
+			/// @brief Call function on every executor.
+			static void for_each(const std::function<void(const Executor &executor)> &method);
+
+			/// @brief Stop all executors, wait for the queued tasks.
+			static void shutdown();
+
+			/// @brief Load limits from XML.
+			void setup(const XML::Node &node);
+
+			/// @brief Get executor state and counters.
+			Udjat::Value & getProperties(Udjat::Value &properties) const;
+
+			/// @brief Queue task, apply the overflow policy if the queue is full.
+			void push(std::function<void()> task);
+
+		};
+
+	}
+
+ }
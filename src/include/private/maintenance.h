@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+ /**
+  * @brief Declares the sqlite maintenance agent.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/sql/script.h>
+ #include <udjat/agent.h>
+ #include <mutex>
+ #include <ctime>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Agent running the database maintenance (checkpoint, optimize, analyze, vacuum).
+		/// @details The agent value is the number of frames left on the WAL after the last run.
+		class UDJAT_PRIVATE Maintenance : public Udjat::Agent<unsigned int> {
+		private:
+
+			/// @brief Custom maintenance statements, run after the built-in ones.
+			const SQL::Script script;
+
+			struct {
+				/// @brief WAL frames forcing a 'TRUNCATE' checkpoint, 0 to truncate on every run.
+				unsigned int checkpoint = 1000;
+
+				/// @brief Free pages triggering an incremental vacuum, 0 to disable.
+				unsigned int vacuum = 1000;
+
+				/// @brief Seconds between 'ANALYZE' runs, 0 to disable.
+				time_t analyze = 86400;
+			} limits;
+
+			mutable std::mutex guard;
+
+			/// @brief Report of the last run.
+			struct {
+				time_t timestamp = 0;
+
+				/// @brief Milliseconds spent.
+				unsigned int elapsed = 0;
+
+				/// @brief WAL frames after the checkpoint, -1 if not in WAL mode.
+				int frames = -1;
+
+				/// @brief WAL frames moved to the database.
+				int checkpointed = -1;
+
+				/// @brief True if the WAL was truncated.
+				bool truncated = false;
+
+				/// @brief Free pages after the vacuum.
+				unsigned int free = 0;
+
+				/// @brief Pages reclaimed by the vacuum.
+				unsigned int reclaimed = 0;
+			} last;
+
+			/// @brief Pages reclaimed since startup.
+			unsigned long long reclaimed = 0;
+
+			/// @brief Timestamp of the last 'ANALYZE'.
+			time_t analyzed = 0;
+
+			/// @brief Warn only once about a database without incremental vacuum.
+			bool warned = false;
+
+		public:
+			Maintenance(const XML::Node &node);
+			virtual ~Maintenance();
+
+			bool refresh(bool b) override;
+
+			Udjat::Value & getProperties(Udjat::Value &value) const override;
+
+		};
+
+	}
+
+ }
@@ -26,6 +26,7 @@
  #include <config.h>
  #include <udjat/defs.h>
  #include <udjat/module/info.h>
+ #include <udjat/tools/value.h>
 
  namespace Udjat {
 
@@ -33,6 +34,12 @@
 
 		extern const ModuleInfo module_info;
 
+		/// @brief Get database engine state (connection pools, statement caches).
+		Udjat::Value & getProperties(Udjat::Value &properties);
+
+		/// @brief Forget the database configuration on module unload, the next load applies its own.
+		void shutdown();
+
 	}
 
  }
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares SQL statement parameter.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/abstract/object.h>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief The native value of a statement parameter.
+		class UDJAT_PRIVATE Parameter {
+		public:
+
+			enum Type : uint8_t {
+				Null,
+				Integer,
+				Real,
+				Text
+			} type = Null;
+
+			long long integer = 0;
+			double real = 0;
+			std::string text;
+
+			/// @brief Get parameter from value, keeping the native type.
+			/// @return false if the value has no property with this name.
+			bool set(const Udjat::Value &value, const char *name);
+
+			/// @brief Get parameter from object property, native for values and agents, text for the others.
+			/// @return false if the object has no property with this name.
+			bool set(const Abstract::Object &object, const char *name);
+
+			/// @brief Set parameter from request or response.
+			/// @return false if the parameter was not found.
+			inline bool set(const Abstract::Object &request, const Udjat::Value &response, const char *name) {
+				return set(request,name) || set(response,name);
+			}
+
+		};
+
+	}
+
+ }
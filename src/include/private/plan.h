@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the compiled alert plan.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/abstract/object.h>
+ #include <udjat/tools/sql/script.h>
+ #include <private/parameter.h>
+ #include <memory>
+ #include <mutex>
+ #include <vector>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Read-only execution plan of an alert script, shared by its activations.
+		class UDJAT_PRIVATE Plan : public std::enable_shared_from_this<Plan> {
+		public:
+
+			struct Statement {
+
+				const char *text;
+				uint8_t kind;
+
+				/// @brief Slow query threshold in milliseconds.
+				unsigned int threshold;
+
+				/// @brief Execution counters, from the script statement.
+				StatementRecord *record;
+
+				/// @brief Value slot of each statement parameter.
+				std::vector<size_t> slots;
+
+				inline bool rows() const noexcept {
+					return kind & Udjat::SQL::Statement::Rows;
+				}
+
+			};
+
+			/// @brief Parameter value, from the activation objects.
+			struct Slot {
+				SQL::Parameter value;
+				bool valid = false;
+			};
+
+			/// @brief The activation values, one for each parameter name.
+			using Slots = std::vector<Slot>;
+
+		private:
+
+			const char *dburl;
+
+			SQL::Script::Transaction mode;
+
+			bool writes = false;
+
+			std::vector<Statement> statements;
+
+			/// @brief Parameter names (quarks), indexed by slot.
+			std::vector<const char *> names;
+
+			mutable std::mutex guard;
+
+			/// @brief Released value arrays, reused by the next activations.
+			mutable std::vector<Slots *> pool;
+
+			/// @brief Return value array to the pool.
+			void recycle(Slots *slots) const noexcept;
+
+		public:
+
+			Plan(const SQL::Script &script);
+			~Plan();
+
+			/// @brief Get an empty value array, reused from previous activations when possible.
+			std::shared_ptr<Slots> acquire() const;
+
+			/// @brief Load the missing values from object properties.
+			void set(Slots &slots, const Abstract::Object &object) const;
+
+			/// @brief Get parameter name.
+			inline const char * name(size_t slot) const noexcept {
+				return names[slot];
+			}
+
+			inline const char * dbconn() const noexcept {
+				return dburl;
+			}
+
+			inline SQL::Script::Transaction transaction() const noexcept {
+				return mode;
+			}
+
+			inline bool readonly() const noexcept {
+				return !writes;
+			}
+
+			inline std::vector<Statement>::const_iterator begin() const {
+				return statements.begin();
+			}
+
+			inline std::vector<Statement>::const_iterator end() const {
+				return statements.end();
+			}
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,188 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the request path index.
+  */
+
+ #pragma once
+ #include <udjat/defs.h>
+ #include <string>
+ #include <string_view>
+ #include <vector>
+ #include <memory>
+ #include <unordered_map>
+ #include <cstring>
+ #include <algorithm>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Index of handlers by request path prefix.
+		/// @tparam T The handler type, with a 'const char * path()' method.
+		template <typename T>
+		class UDJAT_PRIVATE Router {
+		private:
+
+			struct Entry {
+				/// @brief Registration order, the first registered handler wins.
+				size_t index;
+				const T *handler;
+			};
+
+			struct Node {
+				/// @brief Children by path segment, the keys point to the handler paths.
+				std::unordered_map<std::string_view, std::unique_ptr<Node>> children;
+
+				/// @brief Handlers ending on this node, in registration order.
+				std::vector<Entry> entries;
+			};
+
+			/// @brief Handlers indexed by path segments.
+			Node root;
+
+			/// @brief Handlers with wildcards on path, checked on every request.
+			std::vector<Entry> generic;
+
+			size_t count = 0;
+
+			/// @brief Get next path segment.
+			/// @return false if there's no more segments.
+			static bool next(const char * &ptr, std::string_view &segment) noexcept {
+
+				while(*ptr == '/') {
+					ptr++;
+				}
+
+				const char *from = ptr;
+				while(*ptr && *ptr != '/' && *ptr != '?') {
+					ptr++;
+				}
+
+				if(ptr == from) {
+					return false;
+				}
+
+				segment = std::string_view{from,(size_t) (ptr-from)};
+				return true;
+
+			}
+
+			/// @brief Keep the first entry registered after the previous candidate.
+			/// @param entries Entries in registration order.
+			/// @param previous The previous candidate, nullptr to get the first entry.
+			static void select(const std::vector<Entry> &entries, const Entry *previous, const Entry * &selected) noexcept {
+
+				auto entry = entries.begin();
+				if(previous) {
+					entry = std::upper_bound(entries.begin(),entries.end(),previous->index,[](size_t index, const Entry &entry){
+						return index < entry.index;
+					});
+				}
+
+				if(entry != entries.end() && (!selected || entry->index < selected->index)) {
+					selected = &*entry;
+				}
+
+			}
+
+			/// @brief Get the next candidate for path, in registration order.
+			/// @param previous The previous candidate, nullptr to get the first one.
+			/// @return The candidate, nullptr if there's no more.
+			const Entry * candidate(const char *path, const Entry *previous) const noexcept {
+
+				const Entry *selected = nullptr;
+
+				select(generic,previous,selected);
+				select(root.entries,previous,selected);
+
+				const Node *node = &root;
+				std::string_view segment;
+				while(next(path,segment)) {
+					auto child = node->children.find(segment);
+					if(child == node->children.end()) {
+						break;
+					}
+					node = child->second.get();
+					select(node->entries,previous,selected);
+				}
+
+				return selected;
+
+			}
+
+		public:
+
+			/// @brief Add handler to the index.
+			/// @param handler The handler, should be valid while indexed.
+			void push_back(const T &handler) {
+
+				const char *path = handler.path();
+				Entry entry{count++,&handler};
+
+				if(strpbrk(path,"*$?{")) {
+					generic.push_back(entry);
+					return;
+				}
+
+				Node *node = &root;
+				std::string_view segment;
+				while(next(path,segment)) {
+					auto &child = node->children[segment];
+					if(!child) {
+						child = std::make_unique<Node>();
+					}
+					node = child.get();
+				}
+
+				// Registration order grows, the entries stay sorted.
+				node->entries.push_back(entry);
+
+			}
+
+			/// @brief Number of indexed handlers.
+			inline size_t size() const noexcept {
+				return count;
+			}
+
+			/// @brief Find the handler for path.
+			/// @param path The request path.
+			/// @param match Predicate confirming the handler (method, full path).
+			/// @return The first registered handler accepted by predicate, nullptr if none.
+			/// @note Candidates are checked in registration order, the predicate is not called after the first match.
+			template <typename Predicate>
+			const T * find(const char *path, const Predicate &match) const {
+
+				// Walk the path again for each rejected candidate, without allocating on the request.
+				for(const Entry *entry = candidate(path,nullptr); entry; entry = candidate(path,entry)) {
+					if(match(*entry->handler)) {
+						return entry->handler;
+					}
+				}
+
+				return nullptr;
+
+			}
+
+		};
+
+	}
+
+ }
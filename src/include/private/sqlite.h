@@ -25,7 +25,21 @@
  #include <config.h>
  #include <udjat/defs.h>
  #include <mutex>
+ #include <shared_mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <list>
+ #include <unordered_map>
+ #include <atomic>
+ #include <functional>
+ #include <ctime>
+ #include <string>
  #include <sqlite3.h>
+ #include <udjat/tools/xml.h>
+ #include <private/parameter.h>
+ #include <private/cache.h>
+ #include <private/statistics.h>
+ #include <vector>
  #include <udjat/tools/sql/script.h>
  #include <udjat/tools/report.h>
  #include <udjat/tools/request.h>
@@ -35,32 +49,321 @@
 
 	namespace SQL {
 
-		class UDJAT_API Session {
+		/// @brief Pool of persistent connections to a single sqlite database.
+		class UDJAT_PRIVATE Pool {
+		public:
+
+			/// @brief A pooled sqlite3 connection.
+			struct Connection {
+
+				Pool &pool;
+
+				sqlite3 *db = nullptr;
+
+				/// @brief Timestamp of the last release.
+				time_t used = 0;
+
+				/// @brief The pool options revision applied on this connection.
+				unsigned int revision = 0;
+
+				/// @brief Prepared statements, the most recently used first.
+				std::list<std::pair<const char *, sqlite3_stmt *>> statements;
+
+				/// @brief Prepared statements indexed by SQL text.
+				std::unordered_map<const char *, std::list<std::pair<const char *, sqlite3_stmt *>>::iterator> cache;
+
+				/// @brief Tables changed by the running transaction, from the update hook.
+				std::vector<std::string> pending;
+
+				/// @brief Tables changed by committed transactions, notified on release.
+				std::vector<std::string> committed;
+
+				Connection(Pool &pool);
+				~Connection();
+
+				/// @brief Get prepared statement from cache, prepare it on cache miss.
+				/// @param text The SQL text, must be a quark.
+				/// @return The prepared statement, owned by the connection.
+				sqlite3_stmt * prepare(const char *text);
+
+			};
+
+		private:
+
+			/// @brief The database name (interned).
+			const char *dbname;
+
+			mutable std::mutex guard;
+			std::condition_variable released;
+
+			/// @brief Idle connections, the most recently used first.
+			std::list<Connection *> idle;
+
+			/// @brief Number of open connections (idle + borrowed).
+			size_t connections = 0;
+
+			struct {
+				/// @brief Connections kept open even when idle.
+				size_t min = 1;
+
+				/// @brief Maximum number of open connections.
+				size_t max = 8;
+
+				/// @brief Seconds to keep an idle connection open.
+				time_t timeout = 300;
+
+				/// @brief Prepared statements cached on each connection.
+				size_t statements = 32;
+			} limits;
+
+			/// @brief Prepared statement cache counters.
+			struct {
+				std::atomic<unsigned long> hits{0};
+				std::atomic<unsigned long> misses{0};
+				std::atomic<unsigned long> evictions{0};
+			} statistics;
+
+			/// @brief Database changes detected, see generation().
+			std::atomic<unsigned long long> changes{0};
+
+			/// @brief Polls 'PRAGMA data_version' for changes from other processes.
+			struct {
+				std::thread thread;
+				std::condition_variable wakeup;
+				bool enabled = false;
+
+				/// @brief Milliseconds between polls, 0 to disable.
+				unsigned int interval = 1000;
+			} poller;
+
+			/// @brief Poller thread, notify subscriptions on changes from other processes.
+			void poll();
+
+			/// @brief Connection options, applied when opening a connection.
+			struct Options {
+
+				/// @brief Flags for sqlite3_open_v2.
+				int flags = SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE;
+
+				/// @brief Milliseconds to wait on a locked database, 0 to fail immediately.
+				unsigned int busy_timeout = 0;
+
+				/// @brief PRAGMA values, empty to keep the sqlite defaults.
+				std::string journal_mode;
+				std::string synchronous;
+				std::string cache_size;
+				std::string mmap_size;
+				std::string temp_store;
+
+				bool operator==(const Options &options) const noexcept;
+
+			} options;
+
+			/// @brief Options revision, connections with an older one are closed on release.
+			unsigned int revision = 0;
+
+			/// @brief True after the first setup, the options are applied once for each database until the module unload.
+			bool configured = false;
+
+			/// @brief PRAGMA values reported by the last opened connection.
+			struct {
+				std::string journal_mode;
+				std::string synchronous;
+				std::string cache_size;
+				std::string mmap_size;
+				std::string temp_store;
+			} effective;
+
+			/// @brief Close idle connections above the minimum and expired.
+			void cleanup(time_t now);
+
+		public:
+
+			/// @brief Database access lock, shared by readers, exclusive for writers.
+			std::shared_mutex access;
+
+			Pool(const char *dbname);
+			~Pool();
+
+			/// @brief Get the pool for the database.
+			/// @param dbname The database name, should be a quark.
+			static Pool & getInstance(const char *dbname);
+
+			/// @brief Call function on every database pool.
+			static void for_each(const std::function<void(const Pool &pool)> &method);
+
+			/// @brief Module unload, let the next setup() apply its connection options.
+			static void shutdown();
+
+			/// @brief Load pool limits and connection options from XML.
+			void setup(const XML::Node &node);
+
+			/// @brief Get pool state and statement cache counters.
+			Udjat::Value & getProperties(Udjat::Value &properties) const;
+
+			/// @brief Get a connection from pool, open a new one if necessary.
+			Connection * borrow();
+
+			/// @brief Return connection to the pool.
+			void release(Connection *connection);
+
+			/// @brief Signal a database change from this process.
+			inline void changed() noexcept {
+				changes++;
+			}
+
+			/// @brief Start polling the database for changes from other processes.
+			void watch();
+
+			/// @brief Get database generation.
+			/// @return A counter changed on every write from this process or, while watching, from others.
+			inline unsigned long long generation() const noexcept {
+				return changes.load();
+			}
+
+		};
+
+		class UDJAT_API Session : private Statistics::Explainer {
 		private:
+			Pool &pool;
+			Pool::Connection *connection;
 			sqlite3 *db = NULL;
-			static std::mutex guard;
+
+			/// @brief Values bound to the current statement, kept until the next bind.
+			std::vector<Parameter> parameters;
+
+			/// @brief True when the database access lock is held by a transaction.
+			bool locked = false;
+
+			/// @brief Get the query plan for the slow query log.
+			std::string explain(const char *text) override;
 
 		public:
 
+			/// @brief Statistics for the running statement.
+			Statistics::Probe probe;
+
+			/// @brief Lock the database for a statement execution.
+			class Lock {
+			private:
+				Pool &pool;
+				std::shared_mutex &access;
+				sqlite3_stmt *stmt;
+				bool readonly;
+
+				/// @brief False if the session transaction already holds the access lock.
+				bool owner;
+
+			public:
+				Lock(Session &session, sqlite3_stmt *stmt);
+				~Lock();
+
+			};
+
+			/// @brief Explicit transaction, keeps the database access lock until finished.
+			class Transaction {
+			private:
+				Session &session;
+
+				/// @brief True if the transaction doesn't change the database.
+				bool readonly;
+
+				/// @brief True if the access lock is shared.
+				bool shared = false;
+
+				/// @brief True if holding the session access lock.
+				bool owner = false;
+
+				/// @brief True after 'BEGIN'.
+				bool active = false;
+
+				/// @brief Release the access lock.
+				void unlock() noexcept;
+
+			public:
+
+				/// @brief Begin transaction.
+				/// @param mode The transaction mode, does nothing on 'NoTransaction' or if the session is already on a transaction.
+				/// @param readonly True if the transaction doesn't change the database.
+				Transaction(Session &session, SQL::Script::Transaction mode, bool readonly = false);
+
+				/// @brief Begin transaction with the script mode.
+				Transaction(Session &session, const SQL::Script &script);
+
+				/// @brief Rollback, if not commited.
+				~Transaction();
+
+				void commit();
+
+			};
+
 			Session(const char *dbname);
 			~Session();
 
 			void check(int rc);
 
+			/// @brief Execute SQL without parameters or results (transaction control).
+			void exec(const char *sql);
+
+			/// @brief Run rows inside one transaction, with a savepoint for each one.
+			/// @param script The script, selects the transaction mode.
+			/// @param count The number of rows.
+			/// @param exec Execute the script for a row, exceptions roll back only the row.
+			std::vector<SQL::Script::Result> batch(const SQL::Script &script, size_t count, const std::function<void(size_t row, SQL::Script::Result &result)> &exec);
+
+			/// @brief Run rows inside one transaction, with a savepoint for each one.
+			/// @param mode The transaction mode, 'NoTransaction' is handled as 'Immediate'.
+			std::vector<SQL::Script::Result> batch(SQL::Script::Transaction mode, size_t count, const std::function<void(size_t row, SQL::Script::Result &result)> &exec);
+
+			/// @brief Prepare statement, the caller should finalize it.
 			sqlite3_stmt * prepare(const char *script);
+
+			/// @brief Get prepared statement from connection cache.
+			/// @param text The SQL text, must be a quark.
+			/// @return The prepared statement, reset when the Lock is released.
+			sqlite3_stmt * statement(const char *text);
+
+			/// @brief Get prepared statement from connection cache.
 			sqlite3_stmt * prepare(const SQL::Statement &script);
+			/// @brief Bind parameter with its native type.
+			/// @param parameter The parameter value, text is not copied and should be valid until the statement reset.
+			void bind(sqlite3_stmt *stmt, int column, const Parameter &parameter);
+
 			void bind(const SQL::Statement &script, sqlite3_stmt *stmt, const Abstract::Object &request, Udjat::Value &response);
 			void bind(const SQL::Statement &script, sqlite3_stmt *stmt, Udjat::Value &response);
+			void bind(const SQL::Statement &script, sqlite3_stmt *stmt, const Request &request);
+			void bind(const SQL::Statement &script, sqlite3_stmt *stmt, const Abstract::Object &request);
 
+			/// @brief Get column index from name.
+			/// @return The column index, -1 if the statement has no column with the name.
+			int column(sqlite3_stmt *stmt, const char *name);
+
+			/// @brief Run single statement script, get one column from the first row.
+			/// @param fetch Get the value from the column, called only if not null.
+			/// @return true if the value was fetched.
+			bool get(const SQL::Script &script, const Abstract::Object &request, const char *name, const std::function<void(sqlite3_stmt *stmt, int column)> &fetch);
+
+			/// @brief Step statement, get first row (if available).
 			int step(sqlite3_stmt *stmt, Udjat::Value &response);
 
+			/// @brief Step statement, get all rows when the script has a result set.
+			int step(sqlite3_stmt *stmt, Udjat::Value &response, const SQL::Script &script);
+
 			void get(sqlite3_stmt *stmt, Udjat::Value &response);
-			void get(sqlite3_stmt *stmt, Udjat::Response::Table &response);
 
-			void exec(const std::vector<SQL::Statement> &scripts, const Abstract::Object &request, Udjat::Value &response);
-			void exec(const std::vector<SQL::Statement> &scripts, Udjat::Value &response);
-			void exec(const std::vector<SQL::Statement> &scripts, const Request &request, Udjat::Value &response);
-			void exec(const std::vector<SQL::Statement> &scripts, const Request &request, Udjat::Response::Table &response);
+			/// @brief Get current row as table cells.
+			template <typename T>
+			void get(sqlite3_stmt *stmt, T &response);
+
+			/// @brief Run script, send rows to table.
+			template <typename T>
+			void table(const SQL::Script &script, const Request &request, T &response);
+
+			void exec(const SQL::Script &script, const Abstract::Object &request, Udjat::Value &response);
+			void exec(const SQL::Script &script, Udjat::Value &response);
+			void exec(const SQL::Script &script, const Request &request, Udjat::Value &response);
+			void exec(const SQL::Script &script, const Request &request, Udjat::Response::Table &response);
+			void exec(const SQL::Script &script, const Request &request, SQL::Rows &response);
 
 		};
 
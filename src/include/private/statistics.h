@@ -0,0 +1,210 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the per statement statistics.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/report.h>
+ #include <udjat/tools/sql/script.h>
+ #include <atomic>
+ #include <chrono>
+ #include <cstdint>
+ #include <string>
+ #include <vector>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Execution counters, latency histograms and slow query log for each SQL statement.
+		class UDJAT_PRIVATE Statistics {
+		public:
+
+			/// @brief Engine hook to get the query plan of a statement.
+			class UDJAT_PRIVATE Explainer {
+			public:
+				/// @brief Get the query plan.
+				/// @param text The SQL text.
+				/// @return The query plan, one step per line.
+				virtual std::string explain(const char *text) = 0;
+			};
+
+			/// @brief Statement execution phases.
+			enum Phase : uint8_t {
+				Prepare,
+				Bind,
+				Step,
+				Fetch,
+			};
+
+			static constexpr size_t Phases = 4;
+
+			/// @brief Number of histogram buckets, bucket 'n' counts latencies below 2^n microseconds.
+			static constexpr size_t Buckets = 24;
+
+			/// @brief Counters for a single statement.
+			using Record = StatementRecord;
+
+			/// @brief Time a statement execution, does nothing when statistics are disabled.
+			class UDJAT_PRIVATE Probe {
+			private:
+				Explainer *explainer;
+				Record *record = nullptr;
+
+				/// @brief Slow query threshold of the current execution, in microseconds.
+				unsigned long long limit = 0;
+				std::chrono::steady_clock::time_point mark;
+				size_t rows = 0;
+
+				/// @brief Time spent on each phase of the current execution.
+				unsigned long long elapsed[Phases];
+
+				/// @brief Phases reached on the current execution.
+				uint8_t reached = 0;
+
+			public:
+
+				/// @param explainer The engine hook to get query plans for the slow query log.
+				Probe(Explainer *e = nullptr) : explainer{e} {
+				}
+
+				/// @brief Start timing statement.
+				/// @param text The SQL text, must be a quark.
+				/// @param threshold The slow query threshold in milliseconds, 0 to disable.
+				/// @param record The statement record, nullptr to get it from the registry.
+				inline void start(const char *text, unsigned int threshold = 0, Record *record = nullptr) {
+					if(probing.load(std::memory_order_relaxed)) {
+						begin(record ? record : RecordFactory(text),threshold);
+					}
+				}
+
+				/// @brief Start timing statement.
+				inline void start(const SQL::Statement &statement) {
+					if(probing.load(std::memory_order_relaxed)) {
+						begin(statement.record ? statement.record : RecordFactory(statement.text,&statement.parameter_names),statement.threshold);
+					}
+				}
+
+				/// @brief Account time since the last mark to the phase.
+				inline void phase(Phase id) noexcept {
+					if(record) {
+						account(id);
+					}
+				}
+
+				/// @brief Restart timing without accounting (lock waits).
+				inline void resume() noexcept {
+					if(record) {
+						mark = std::chrono::steady_clock::now();
+					}
+				}
+
+				/// @brief Count a returned row.
+				inline void row() noexcept {
+					rows++;
+				}
+
+				/// @brief Stop timing, store counters.
+				/// @param failed true if the statement has failed.
+				void finish(bool failed = false) noexcept;
+
+			private:
+				void begin(Record *record, unsigned int threshold) noexcept;
+				void account(Phase id) noexcept;
+				void slow(unsigned long long elapsed, bool failed) noexcept;
+
+			};
+
+			/// @brief True if the statistics are being collected.
+			static inline bool enabled() noexcept {
+				return active.load(std::memory_order_relaxed);
+			}
+
+			/// @brief Start collecting and setup slow query log from node (or from the 'sql' configuration group).
+			/// @return The slow query threshold for the node statements, in milliseconds.
+			static unsigned int setup(const XML::Node &node);
+
+			/// @brief Start collecting.
+			static void enable() noexcept;
+
+			/// @brief Get the record of a statement, creating it on the first call.
+			/// @param text The SQL text, must be a quark.
+			/// @param names The statement parameter names, nullptr if unknown.
+			/// @return The statement record, valid until the process ends.
+			static Record * RecordFactory(const char *text, const std::vector<const char *> *names = nullptr);
+
+			/// @brief Get counters for all statements.
+			static Udjat::Value & getProperties(Udjat::Value &properties);
+
+			/// @brief Get counters for all statements as a report.
+			static void get(Udjat::Response::Table &response);
+
+		private:
+
+			/// @brief True if collecting counters.
+			static std::atomic<bool> active;
+
+			/// @brief True if collecting counters or logging slow queries.
+			static std::atomic<bool> probing;
+
+		};
+
+		/// @brief Counters for a single statement, registered once and never released.
+		struct UDJAT_PRIVATE StatementRecord {
+
+			/// @brief The SQL text (interned).
+			const char *text;
+
+			/// @brief Names of the statement parameters, empty if unknown.
+			std::vector<const char *> names;
+
+			/// @brief The query plan, captured on the first slow execution.
+			std::string plan;
+			bool explained = false;
+
+			std::atomic<unsigned long> executions{0};
+			std::atomic<unsigned long> errors{0};
+			std::atomic<unsigned long> rows{0};
+
+			struct Histogram {
+				std::atomic<unsigned long> buckets[Statistics::Buckets] = {};
+				std::atomic<unsigned long long> total{0};
+				std::atomic<unsigned long long> max{0};
+
+				void add(unsigned long long microseconds) noexcept;
+
+				/// @brief Get approximate percentile from the buckets.
+				unsigned long long percentile(double value) const noexcept;
+
+			} phases[Statistics::Phases];
+
+			StatementRecord(const char *t) : text{t} {
+			}
+
+		};
+
+	}
+
+ }
@@ -26,6 +26,16 @@
  #include <udjat/tools/xml.h>
  #include <udjat/agent/sql.h>
  #include <udjat/tools/protocol.h>
+ #include <thread>
+ #include <mutex>
+ #include <condition_variable>
+ #include <atomic>
+ #include <ctime>
+ #include <memory>
+ #include <future>
+ #include <vector>
+ #include <string>
+ #include <private/buffer.h>
 
  namespace Udjat {
 
@@ -43,12 +53,116 @@
 			/// @brief SQL Script to remove URL sent from queue.
 			const SQL::Script after_send;
 
-			/// @brief Seconds to wait after a sucessfull send to send another queued row.
+			/// @brief SQL Script to mark rows as claimed by ${claim} for ${lease} seconds, empty to send without claiming.
+			const SQL::Script claim;
+
+			/// @brief SQL Script to release the claim of a row not sent.
+			const SQL::Script release;
+
+			/// @brief Seconds a claim is valid, expired claims can be taken by other senders.
+			time_t lease;
+
+			/// @brief Unique identifier of this queue instance, prefix of the claim tokens.
+			const std::string claimer;
+
+			/// @brief Claims made by this instance.
+			std::atomic<unsigned long> claims{0};
+
+			/// @brief Seconds to wait before retrying after a failed send.
 			time_t send_interval;
 
 			/// @brief Interval to send after inserting url on queue.
 			time_t send_delay;
 
+			/// @brief Maximum concurrent remote calls while sending a batch.
+			size_t senders;
+
+			/// @brief Queue depth, kept in memory and reconciled with the table.
+			std::atomic<size_t> depth{0};
+
+			/// @brief Seconds between queue depth reconciliations, 0 to count on every refresh.
+			time_t reconcile_interval;
+
+			/// @brief Timestamp of the last reconciliation.
+			time_t reconciled = 0;
+
+			/// @brief Publish the queue depth as agent value.
+			void update_depth();
+
+			/// @brief A queued request waiting for the group commit.
+			struct Insert {
+				std::shared_ptr<Udjat::Value> value;
+
+				/// @brief Fulfilled on commit, nullptr if acknowledged on enqueue.
+				std::shared_ptr<std::promise<void>> done;
+			};
+
+			/// @brief Group commit buffer for inserts, nullptr to insert synchronously.
+			std::unique_ptr<SQL::Buffer<Insert>> buffer;
+
+			/// @brief True to acknowledge the queued request only after the commit.
+			bool durable = true;
+
+			/// @brief Insert buffered requests in one transaction.
+			void flush(std::vector<Insert> &inserts);
+
+			/// @brief Background thread sending the queued rows, started on the first refresh.
+			std::thread dispatcher;
+
+			/// @brief Sender threads helping the dispatcher on each batch, 'senders' - 1 of them.
+			std::vector<std::thread> workers;
+
+			std::mutex guard;
+
+			/// @brief Signaled when a send is requested or the agent is being destroyed.
+			std::condition_variable wakeup;
+
+			/// @brief True when the refresh requested a send.
+			bool requested = false;
+
+			/// @brief False when the agent is being destroyed.
+			bool enabled = true;
+
+			/// @brief The batch being sent, shared by the dispatcher and the workers.
+			struct {
+				const std::vector<std::shared_ptr<Udjat::Value>> *rows = nullptr;
+				std::vector<char> *sent = nullptr;
+
+				/// @brief Next row to send.
+				std::atomic<size_t> next{0};
+
+				/// @brief Batch number, tells the workers there's a new batch.
+				unsigned long id = 0;
+
+				/// @brief Workers still sending the batch.
+				size_t busy = 0;
+
+				/// @brief Signaled when a batch is ready for the workers.
+				std::condition_variable ready;
+
+				/// @brief Signaled when a worker finishes the batch.
+				std::condition_variable finished;
+			} batch;
+
+			/// @brief True if the agent is not being destroyed.
+			bool active();
+
+			/// @brief Dispatcher thread, sends batches when requested.
+			void dispatch();
+
+			/// @brief Worker thread, helps sending the batches.
+			void work();
+
+			/// @brief Send rows from the current batch until there's no more or the agent is being destroyed.
+			void send_batch();
+
+			/// @brief Send a queued row.
+			/// @return true if the row was sent and can be removed from queue.
+			bool transmit(const Udjat::Value &row) const;
+
+			/// @brief Send batches of queued rows until the queue is empty or a send fails.
+			void drain();
+
 			/// @brief Compute State based on queue size.
 			std::shared_ptr<Abstract::State> computeState() override;
 
@@ -58,6 +172,8 @@
 
 			bool refresh(bool b) override;
 
+			Udjat::Value & getProperties(Udjat::Value &value) const override;
+
 			std::shared_ptr<Protocol::Worker> WorkerFactory() const override;
 
 		};
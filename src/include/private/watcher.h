@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the database change watcher.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/sql/script.h>
+ #include <functional>
+ #include <string>
+ #include <vector>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Subscription for changes on database tables, active while alive.
+		class UDJAT_PRIVATE Subscription {
+		private:
+
+			/// @brief The database connection string (interned).
+			const char *dburl;
+
+			/// @brief The watched tables, empty for any change on the database.
+			std::vector<std::string> tables;
+
+			/// @brief Called when the tables change.
+			std::function<void()> method;
+
+			/// @brief True to be notified of changes from other processes, the changed tables are unknown for them.
+			bool external;
+
+		public:
+
+			/// @brief Subscribe for changes.
+			/// @param dburl The database connection string (interned).
+			/// @param tables Comma separated table names, '*' for any change on the database.
+			/// @param external True to be notified of every change from other processes.
+			Subscription(const char *dburl, const char *tables, const std::function<void()> &method, bool external = false);
+			~Subscription();
+
+			inline const char * dbconn() const noexcept {
+				return dburl;
+			}
+
+			/// @brief True if the subscription depends on any of the tables.
+			/// @param tables The changed tables, empty if unknown.
+			bool depends(const std::vector<std::string> &tables) const noexcept;
+
+			inline bool accepts_external() const noexcept {
+				return external;
+			}
+
+			inline void changed() const {
+				method();
+			}
+
+		};
+
+		/// @brief Notify database changes to the subscriptions.
+		namespace Watcher {
+
+			/// @brief Notify changes on tables.
+			/// @param dburl The database connection string (interned).
+			/// @param tables The changed tables, empty to notify every subscription on the database.
+			UDJAT_PRIVATE void changed(const char *dburl, const std::vector<std::string> &tables = std::vector<std::string>());
+
+			/// @brief Notify a change from other process to the subscriptions accepting them.
+			/// @param dburl The database connection string (interned).
+			UDJAT_PRIVATE void external(const char *dburl);
+
+		}
+
+	}
+
+ }
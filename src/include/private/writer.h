@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+ /**
+  * @brief Declares the asynchronous alert writer.
+  */
+
+ #pragma once
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <private/buffer.h>
+ #include <mutex>
+ #include <memory>
+ #include <vector>
+ #include <functional>
+ #include <unordered_map>
+
+ namespace Udjat {
+
+	namespace SQL {
+
+		/// @brief Background writers for asynchronous alerts, one for each database.
+		/// @details Activations queued on a writer are merged in one transaction for each flush, implemented by the engine.
+		namespace Writer {
+
+			/// @brief Load the writer limits for the database.
+			/// @param dburl The database connection string (interned).
+			UDJAT_PRIVATE void setup(const char *dburl, const XML::Node &node);
+
+			/// @brief Append the state of every writer.
+			UDJAT_PRIVATE void getProperties(Udjat::Value &writers);
+
+			/// @brief Flush the queued activations and stop the writers.
+			UDJAT_PRIVATE void shutdown();
+
+		}
+
+		/// @brief Activation results, each run works on its own copy and publishes it when finished.
+		class UDJAT_PRIVATE Results {
+		private:
+			mutable std::mutex guard;
+			std::shared_ptr<Udjat::Value> value;
+
+		public:
+			Results() : value{Udjat::Value::ObjectFactory()} {
+			}
+
+			/// @brief Get a copy of the last published results.
+			std::shared_ptr<Udjat::Value> get() const {
+				auto copy = Udjat::Value::ObjectFactory();
+				std::lock_guard<std::mutex> lock(guard);
+				copy->set(*value);
+				return copy;
+			}
+
+			/// @brief Publish the results of a finished run.
+			void publish(std::shared_ptr<Udjat::Value> results) {
+				std::lock_guard<std::mutex> lock(guard);
+				value = results;
+			}
+
+			Udjat::Value & getProperties(Udjat::Value &properties) const {
+				std::lock_guard<std::mutex> lock(guard);
+				value->getProperties(properties);
+				return properties;
+			}
+
+		};
+
+		/// @brief The writer buffers, one for each database.
+		/// @tparam Job The engine activation, runs its statements on the flush transaction.
+		template <typename Job>
+		class UDJAT_PRIVATE Writers {
+		private:
+
+			/// @brief Run jobs in one transaction.
+			const std::function<void(const char *dburl, std::vector<Job> &jobs)> flush;
+
+			mutable std::mutex guard;
+
+			std::unordered_map<const char *, std::unique_ptr<Buffer<Job>>> buffers;
+
+		public:
+
+			Writers(const std::function<void(const char *dburl, std::vector<Job> &jobs)> &f) : flush{f} {
+			}
+
+			/// @brief Get the writer for the database.
+			/// @param dburl The database connection string (interned).
+			Buffer<Job> & operator[](const char *dburl) {
+
+				std::lock_guard<std::mutex> lock(guard);
+
+				auto &buffer = buffers[dburl];
+				if(!buffer) {
+					buffer = std::make_unique<Buffer<Job>>("alerts",[this,dburl](std::vector<Job> &jobs){
+						flush(dburl,jobs);
+					});
+				}
+
+				return *buffer;
+
+			}
+
+			void setup(const char *dburl, const XML::Node &node) {
+				(*this)[dburl].setup(node,"sql","alert-buffer");
+			}
+
+			void getProperties(Udjat::Value &writers) const {
+
+				std::lock_guard<std::mutex> lock(guard);
+
+				for(const auto &buffer : buffers) {
+					Udjat::Value &value = writers.append(Udjat::Value::Object);
+					value["database"] = buffer.first;
+					buffer.second->getProperties(value);
+				}
+
+			}
+
+			void shutdown() {
+
+				// Stop outside of the lock, the flush can take a while.
+				std::vector<Buffer<Job> *> stopping;
+				{
+					std::lock_guard<std::mutex> lock(guard);
+					for(auto &buffer : buffers) {
+						stopping.push_back(buffer.second.get());
+					}
+				}
+
+				for(auto buffer : stopping) {
+					buffer->stop();
+				}
+
+			}
+
+		};
+
+	}
+
+ }
@@ -27,13 +27,69 @@
  #include <udjat/agent/abstract.h>
  #include <udjat/tools/sql/script.h>
  #include <udjat/agent.h>
+ #include <type_traits>
+ #include <string>
+ #include <memory>
+ #include <vector>
 
  namespace Udjat {
 
 	namespace SQL {
 
+		/// @brief SQL agents sharing one query, the parent results feed the child values.
+		class UDJAT_API Group {
+		private:
+
+			/// @brief Agents updated from this agent query.
+			std::vector<std::shared_ptr<Group>> children;
+
+			/// @brief The column with the agent value on the parent results.
+			const char *column;
+
+			/// @brief Row selection on multi-row parent results.
+			struct {
+				/// @brief The column with the row key, nullptr to use the first row.
+				const char *column = nullptr;
+
+				/// @brief The row key.
+				const char *value = "";
+			} key;
+
+			/// @brief Value when the parent results have no row or column for the agent, nullptr to keep the current one.
+			const char *missing = nullptr;
+
+			/// @brief True if the agent has no query of its own, the value comes from the parent.
+			bool fed;
+
+		protected:
+
+			Group(const XML::Node &node, const char *column);
+
+			/// @brief Set agent value from the parent results.
+			virtual bool feed(const char *value) = 0;
+
+			/// @brief True if the agent query feeds other agents.
+			inline bool grouped() const noexcept {
+				return !children.empty();
+			}
+
+			/// @brief Add agent updated from this agent query, if it has no query of its own.
+			/// @return true if the agent was added.
+			bool attach(std::shared_ptr<Group> child);
+
+			/// @brief Update the children from the query results.
+			/// @param results The query results.
+			/// @param result_set The name of the rows array, nullptr for single row results.
+			void distribute(const Udjat::Value &results, const char *result_set) const;
+
+		public:
+
+			virtual ~Group();
+
+		};
+
 		template <typename T>
-		class UDJAT_API Agent : public Udjat::Agent<T> {
+		class UDJAT_API Agent : public Udjat::Agent<T>, public Group {
 		private:
 
 			/// @brief SQL Script to update agent value.
@@ -45,14 +101,26 @@
 			/// @brief The name of agent value got by SQL query.
 			const char *value_name;
 
+			/// @brief Refresh on changes of the 'depends-on' tables, released before the agent.
+			std::shared_ptr<SQL::Subscription> subscription;
+
 		public:
 
 			Agent(const XML::Node &node) :
 				Udjat::Agent<T>{node},
+					Group{node,Quark{node,"value-from","value"}.c_str()},
 					update{node,"refresh",true,false},
 					properties{node,"properties",true,false},
 					value_name{Quark{node,"value-from","value"}.c_str()} {
 				SQL::Script::init(node);
+
+				const char *tables = node.attribute("depends-on").as_string();
+				if(tables && *tables && update.size()) {
+					subscription = update.watch(tables,[this](){
+						this->sched_update(0);
+					},node.attribute("external-changes").as_bool(false));
+				}
+
 			}
 
 			bool refresh(bool) override {
@@ -61,12 +129,51 @@
 					return false;
 				}
 
+				if(update.size() == 1 && !update.result_set() && !grouped()) {
+
+					// Single statement and single row, read the column straight into the agent type.
+					// Without value (no row, null or missing column) assign an empty one, as the generic path.
+					if constexpr (std::is_integral<T>::value) {
+						long long value;
+						return update.get(*this,value_name,value) ? this->set((T) value) : this->assign("");
+					} else if constexpr (std::is_floating_point<T>::value) {
+						double value;
+						return update.get(*this,value_name,value) ? this->set((T) value) : this->assign("");
+					} else if constexpr (std::is_same<T,std::string>::value) {
+						std::string value;
+						return update.get(*this,value_name,value) ? this->set(value) : this->assign("");
+					}
+
+				}
+
 				std::shared_ptr<Udjat::Value> value = Udjat::Value::ObjectFactory();
 				update.exec(*this,*value);
+
+				if(grouped()) {
+
+					// One query for all children, their states are computed from the shared results.
+					distribute(*value,update.result_set());
+
+					if((*value)[value_name].isNull()) {
+						// No value for the parent, it's just the group.
+						return false;
+					}
+
+				}
+
 				return this->assign((*value)[value_name].as_string().c_str());
 
 			}
 
+			bool feed(const char *value) override {
+				return this->assign(value);
+			}
+
+			void push_back(std::shared_ptr<Udjat::Abstract::Agent> child) override {
+				Udjat::Agent<T>::push_back(child);
+				attach(std::dynamic_pointer_cast<Group>(child));
+			}
+
 			bool getProperties(const char *path, Value &value) const override {
 
 				if(properties.size()) {
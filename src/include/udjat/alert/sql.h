@@ -28,11 +28,14 @@
  #include <udjat/tools/sql/script.h>
  #include <udjat/alert/abstract.h>
  #include <udjat/alert/activation.h>
+ #include <memory>
 
  namespace Udjat {
 
 	namespace SQL {
 
+		class Plan;
+
 		/// @brief Default alert (based on URL and payload).
 		class UDJAT_API Alert : public Abstract::Alert {
 		protected:
@@ -40,6 +43,12 @@
 			/// @brief SQL Script to run on alert activation.
 			const SQL::Script script;
 
+			/// @brief True to queue the activations on the database writer instead of running them on emit.
+			bool async = false;
+
+			/// @brief Compiled script, shared by all activations.
+			std::shared_ptr<const Plan> plan;
+
 			/// @brief Create an alert activation.
 			std::shared_ptr<Udjat::Alert::Activation> ActivationFactory() const override;
 
@@ -27,29 +27,43 @@
  #include <udjat/tools/method.h>
  #include <udjat/tools/sql/script.h>
  #include <udjat/tools/abstract/request-path.h>
+ #include <memory>
+ #include <string>
 
  namespace Udjat {
 
 	namespace SQL {
 
+		class Cache;
+
 		/// @brief Map an Udjat::Worker path to SQL Query.
 		class UDJAT_PRIVATE ApiCall : public RequestPath, private SQL::Script {
 		private:
 			Worker::ResponseType type = Worker::None;	///< @brief Response type for this query.
 
+			/// @brief Result cache, nullptr if disabled.
+			std::unique_ptr<Cache> cache;
+
+			/// @brief Built-in report instead of the SQL script.
+			enum Report : uint8_t {
+				NoReport,
+				StatisticsReport,
+			} report = NoReport;
+
+			/// @brief Build cache key from the statement parameters.
+			/// @return false if some parameter is missing.
+			bool key(const Request &request, const Udjat::Value *response, std::string &key) const;
+
 		public:
 			ApiCall(const XML::Node &node);
+			~ApiCall();
 
 			inline operator Worker::ResponseType() const noexcept {
 				return type;
 			}
 
-			template <typename T>
-			bool exec(Request &request, T &response) const {
-				head(request,response);
-				Script::exec(request,response);
-				return true;
-			}
+			bool exec(Request &request, Response::Value &response) const;
+			bool exec(Request &request, Response::Table &response) const;
 
 		};
 
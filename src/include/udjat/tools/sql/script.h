@@ -31,19 +31,60 @@
  #include <udjat/tools/response.h>
  #include <udjat/tools/report.h>
  #include <vector>
+ #include <string>
  #include <memory>
+ #include <cstdint>
+ #include <functional>
+ #include <future>
+ #include <exception>
 
  namespace Udjat {
 
 	namespace SQL {
 
+		class Rows;
+		class Subscription;
+		struct StatementRecord;
+
 		/// @brief A single SQL statement.
 		class UDJAT_API Statement {
 		public:
+
+			/// @brief Statement kind flags.
+			enum Kind : uint8_t {
+				Unknown		= 0x00,
+				ReadOnly	= 0x01,		///< @brief Statement doesn't change the database.
+				Rows		= 0x02,		///< @brief Statement returns rows.
+				Write		= 0x04,		///< @brief Statement changes the database.
+			};
+
 			const char *text;
 			std::vector<const char *> parameter_names;
+
+			/// @brief Statement kind, computed from the SQL text on load.
+			uint8_t kind = Unknown;
+
+			/// @brief Slow query threshold in milliseconds, from the script node, 0 to disable.
+			unsigned int threshold = 0;
+
+			/// @brief Execution counters, resolved on load to keep the registry out of the executions.
+			StatementRecord *record = nullptr;
+
 			Statement(const char *script);
 
+			/// @brief Get statement kind from SQL text.
+			static uint8_t KindFactory(const char *text);
+
+			/// @brief True if the statement returns rows.
+			inline bool rows() const noexcept {
+				return kind & Rows;
+			}
+
+			/// @brief True if the statement doesn't change the database.
+			inline bool readonly() const noexcept {
+				return kind & ReadOnly;
+			}
+
 		};
 
 		/// @brief An SQL statement.
@@ -59,6 +100,29 @@
 
 			virtual ~Script();
 
+			/// @brief Transaction mode.
+			enum Transaction : uint8_t {
+				NoTransaction,		///< @brief Autocommit, every statement is a transaction.
+				Deferred,			///< @brief Begin a transaction, lock the database on first access.
+				Immediate,			///< @brief Begin a transaction getting the write lock.
+				Exclusive,			///< @brief Begin a transaction locking the database for readers and writers.
+			};
+
+			/// @brief Result of a single row on batch execution.
+			struct Result {
+
+				/// @brief The row values, updated with the script results.
+				std::shared_ptr<Udjat::Value> response;
+
+				/// @brief The error message, empty if the row was executed.
+				std::string error;
+
+				inline operator bool() const noexcept {
+					return error.empty();
+				}
+
+			};
+
 			/// @brief False if query is empty.
 			inline size_t size() const noexcept {
 				return scripts.size();
@@ -85,6 +149,58 @@
 
 			void exec(std::shared_ptr<Udjat::Value> response) const;
 
+			/// @brief Queue SQL query on the database executor.
+			/// @param response The values for the query parameters, receives the results.
+			/// @param completion Called from the executor thread when the query ends, with the exception if failed.
+			/// @exception std::runtime_error if the executor queue is full and the overflow policy is 'reject'.
+			void async(std::shared_ptr<Udjat::Value> response, const std::function<void(std::exception_ptr error)> &completion) const;
+
+			/// @brief Queue SQL query on the database executor.
+			/// @param response The values for the query parameters, receives the results.
+			/// @return Future for query completion, rethrows the query exception.
+			/// @exception std::runtime_error if the executor queue is full and the overflow policy is 'reject'.
+			std::future<void> async(std::shared_ptr<Udjat::Value> response) const;
+
+			/// @brief Execute single statement query, get one column from the first row.
+			/// @param request The object with the values.
+			/// @param column The column name.
+			/// @param value Receives the column value, unchanged if there's no row, the column is null or missing.
+			/// @return true if the value was set.
+			/// @exception std::runtime_error if the script has more than one statement.
+			bool get(const Udjat::Object &request, const char *column, long long &value) const;
+
+			/// @brief Execute single statement query, get one column from the first row.
+			bool get(const Udjat::Object &request, const char *column, double &value) const;
+
+			/// @brief Execute single statement query, get one column from the first row.
+			bool get(const Udjat::Object &request, const char *column, std::string &value) const;
+
+			/// @brief Execute SQL query, capture rows for replay.
+			void exec(const Request &request, Rows &response) const;
+
+			/// @brief Execute SQL query for every set of values in a single transaction.
+			/// @param values The values for the query parameters, one for each row, receive the results.
+			/// @return The result for each row, failed rows are rolled back without aborting the batch.
+			std::vector<Result> batch(const std::vector<std::shared_ptr<Udjat::Value>> &values) const;
+
+			/// @brief Execute SQL query for every set of values in a single transaction.
+			/// @param request The object with the values shared by all rows, searched before the row values.
+			/// @param values The values for the query parameters, one for each row, receive the results.
+			/// @return The result for each row, failed rows are rolled back without aborting the batch.
+			std::vector<Result> batch(const Udjat::Object &request, const std::vector<std::shared_ptr<Udjat::Value>> &values) const;
+
+			/// @brief Execute SQL query for every request in a single transaction.
+			/// @param requests The objects with the values, one for each row.
+			/// @return The result for each row, failed rows are rolled back without aborting the batch.
+			std::vector<Result> batch(const std::vector<const Udjat::Object *> &requests) const;
+
+			/// @brief Watch the script database for changes.
+			/// @param tables Comma separated table names, '*' for any change on the database.
+			/// @param changed Called from the thread detecting the change, should just schedule the work.
+			/// @param external True to be called on every change from other processes, the tables filter only the writes from this one.
+			/// @return The subscription, active until released.
+			std::shared_ptr<Subscription> watch(const char *tables, const std::function<void()> &changed, bool external = false) const;
+
 			/// @brief Execute SQL query.
 			static void exec(const XML::Node &node);
 
@@ -99,6 +215,18 @@
 
 			std::vector<Statement> scripts;
 
+			/// @brief Transaction mode, from the 'transaction' attribute or the engine default.
+			Transaction mode = NoTransaction;
+
+			/// @brief Options for statements returning rows.
+			struct {
+				/// @brief Name of the array receiving all rows, nullptr to get only the first one.
+				const char *name = nullptr;
+
+				/// @brief Maximum number of rows, 0 for unlimited.
+				size_t max = 0;
+			} rows;
+
 			static const char * parse(Udjat::String &query);
 			void push_back(const XML::Node &node, bool allow_empty = false);
 
@@ -108,6 +236,24 @@
 				return dburl;
 			}
 
+			/// @brief Name of the array for multi-row results, nullptr for single row.
+			inline const char *result_set() const noexcept {
+				return rows.name;
+			}
+
+			/// @brief Maximum number of rows to fetch, 0 for unlimited.
+			inline size_t max_rows() const noexcept {
+				return rows.max;
+			}
+
+			/// @brief Transaction mode for the script execution.
+			inline Transaction transaction() const noexcept {
+				return mode;
+			}
+
+			/// @brief True if no statement can change the database.
+			bool readonly() const noexcept;
+
 			inline const auto begin() const {
 				return scripts.begin();
 			}
@@ -28,12 +28,17 @@
  #include <udjat/alert/activation.h>
  #include <udjat/alert/sql.h>
  #include <udjat/tools/value.h>
+ #include <private/writer.h>
+ #include <private/plan.h>
 
  using namespace std;
 
  namespace Udjat {
 
-	SQL::Alert::Alert(const XML::Node &node, const char *defaults) : Abstract::Alert(node,defaults), script{node} {
+	SQL::Alert::Alert(const XML::Node &node, const char *defaults) : Abstract::Alert(node,defaults), script{node}, async{node.attribute("async").as_bool(false)}, plan{make_shared<Plan>(script)} {
+		if(async) {
+			SQL::Writer::setup(script.dbconn(),node);
+		}
 	}
 
 
@@ -26,11 +26,159 @@
  #include <udjat/tools/xml.h>
  #include <udjat/tools/sql/apicall.h>
  #include <udjat/tools/logger.h>
+ #include <private/cache.h>
+ #include <private/parameter.h>
+ #include <private/statistics.h>
+ #include <udjat/tools/string.h>
+ #include <stdexcept>
+ #include <string>
+
+#ifdef HAVE_SQLITE3
+ #include <private/sqlite.h>
+#endif // HAVE_SQLITE3
+
+ using namespace std;
 
  namespace Udjat {
 
 	SQL::ApiCall::ApiCall(const XML::Node &node)
-		: RequestPath{node}, SQL::Script{node}, type{Worker::ResponseTypeFactory(node,"response-type","table")} {
+		: RequestPath{node}, SQL::Script{node,"script",node.attribute("report").as_string()[0] != '\0'}, type{Worker::ResponseTypeFactory(node,"response-type","table")} {
+
+		if(node.attribute("report")) {
+
+			switch(String{node,"report",""}.select("statistics",nullptr)) {
+			case 0:	// Statement statistics, exposing them implies collecting.
+				report = StatisticsReport;
+				Statistics::enable();
+				break;
+
+			default:
+				throw runtime_error(Logger::String{"Unexpected report '",node.attribute("report").as_string(),"'"});
+			}
+
+			return;
+		}
+
+		if(node.attribute("cache").as_uint(0)) {
+
+			for(const auto &statement : *this) {
+				if(!statement.readonly()) {
+					Logger::String{"Ignoring cache on '",path(),"', the script can change the database"}.warning("sql");
+					return;
+				}
+			}
+
+			cache = make_unique<Cache>(node);
+
+#ifdef HAVE_SQLITE3
+			// Writes from other processes are detected by polling the database.
+			SQL::Pool::getInstance(dbconn()).watch();
+#endif // HAVE_SQLITE3
+
+		}
+
+	}
+
+	SQL::ApiCall::~ApiCall() {
+	}
+
+	bool SQL::ApiCall::key(const Request &request, const Udjat::Value *response, std::string &key) const {
+
+		Parameter parameter;
+
+		for(const auto &statement : *this) {
+			for(const char *name : statement.parameter_names) {
+
+				if(!(parameter.set(request,name) || (response && parameter.set(*response,name)))) {
+					return false;
+				}
+
+				key += (char) ('0' + parameter.type);
+				switch(parameter.type) {
+				case Parameter::Null:
+					break;
+
+				case Parameter::Integer:
+					key += std::to_string(parameter.integer);
+					break;
+
+				case Parameter::Real:
+					key += std::to_string(parameter.real);
+					break;
+
+				case Parameter::Text:
+					key += parameter.text;
+					break;
+
+				}
+				key += '\0';
+
+			}
+		}
+
+		return true;
+
+	}
+
+	bool SQL::ApiCall::exec(Request &request, Response::Value &response) const {
+
+		head(request,response);
+
+		if(report == StatisticsReport) {
+			Statistics::getProperties(response);
+			return true;
+		}
+
+		string key;
+		if(!(cache && this->key(request,&response,key))) {
+			Script::exec(request,response);
+			return true;
+		}
+
+		// Get generation before the query, any write from now on invalidates the entry.
+		unsigned long long generation = SQL::generation(dbconn());
+
+		if(cache->get(key,generation,response)) {
+			debug("Using cached response for '",path(),"'");
+			return true;
+		}
+
+		Script::exec(request,response);
+		cache->put(key,generation,response);
+
+		return true;
+
+	}
+
+	bool SQL::ApiCall::exec(Request &request, Response::Table &response) const {
+
+		head(request,response);
+
+		if(report == StatisticsReport) {
+			Statistics::get(response);
+			return true;
+		}
+
+		string key;
+		if(!(cache && this->key(request,nullptr,key))) {
+			Script::exec(request,response);
+			return true;
+		}
+
+		unsigned long long generation = SQL::generation(dbconn());
+
+		if(cache->get(key,generation,response)) {
+			debug("Using cached table for '",path(),"'");
+			return true;
+		}
+
+		auto rows = make_shared<Rows>();
+		Script::exec(request,*rows);
+		cache->put(key,generation,rows);
+		rows->replay(response);
+
+		return true;
+
 	}
 
  }
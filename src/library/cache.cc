@@ -0,0 +1,257 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the api-call result cache.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/object.h>
+ #include <private/cache.h>
+ #include <stdexcept>
+ #include <cstring>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	void SQL::Rows::start(const std::vector<std::string> &names) {
+		columns = names;
+	}
+
+	SQL::Rows & SQL::Rows::push_back(int value) {
+		cells.emplace_back();
+		cells.back().type = Parameter::Integer;
+		cells.back().integer = value;
+		return *this;
+	}
+
+	SQL::Rows & SQL::Rows::push_back(double value) {
+		cells.emplace_back();
+		cells.back().type = Parameter::Real;
+		cells.back().real = value;
+		return *this;
+	}
+
+	SQL::Rows & SQL::Rows::push_back(const char *value) {
+		cells.emplace_back();
+		cells.back().type = Parameter::Text;
+		cells.back().text = value;
+		return *this;
+	}
+
+	size_t SQL::Rows::size() const noexcept {
+
+		size_t size = sizeof(*this) + (cells.capacity() * sizeof(Parameter));
+
+		for(const auto &column : columns) {
+			size += sizeof(column) + column.capacity();
+		}
+
+		for(const auto &cell : cells) {
+			size += cell.text.capacity();
+		}
+
+		return size;
+	}
+
+	void SQL::Rows::replay(Udjat::Response::Table &response) const {
+
+		if(!columns.empty()) {
+			response.start(columns);
+		}
+
+		for(const auto &cell : cells) {
+
+			switch(cell.type) {
+			case Parameter::Null:
+				response.push_back("");
+				break;
+
+			case Parameter::Integer:
+				// Captured from an int, no loss.
+				response.push_back((int) cell.integer);
+				break;
+
+			case Parameter::Real:
+				response.push_back(cell.real);
+				break;
+
+			case Parameter::Text:
+				response.push_back(cell.text.c_str());
+				break;
+
+			}
+
+		}
+
+		if(counted) {
+			response.count(rows);
+		}
+
+	}
+
+	/// @brief Approximate memory used by a value.
+	static size_t size_of(const Udjat::Value &value) {
+
+		size_t size = sizeof(value);
+
+		switch((Udjat::Value::Type) value) {
+		case Udjat::Value::Array:
+		case Udjat::Value::Object:
+			value.for_each([&size](const char *name, const Udjat::Value &child){
+				size += strlen(name) + size_of(child);
+				return false;
+			});
+			break;
+
+		default:
+			size += value.to_string().size();
+		}
+
+		return size;
+
+	}
+
+	SQL::Cache::Cache(const XML::Node &node) {
+
+		limits.ttl = node.attribute("cache").as_uint(0);
+		limits.entries = Object::getAttribute(node, "sql", "cache-max-entries", (unsigned int) limits.entries);
+		limits.size = Object::getAttribute(node, "sql", "cache-max-size", (unsigned int) limits.size);
+
+		if(limits.ttl && !(limits.entries && limits.size)) {
+			throw runtime_error("The api-call cache requires at least one entry");
+		}
+
+	}
+
+	const SQL::Cache::Entry * SQL::Cache::find(const std::string &key, unsigned long long generation) {
+
+		auto it = index.find(key);
+		if(it == index.end()) {
+			return nullptr;
+		}
+
+		auto entry = it->second;
+		if(entry->generation != generation || entry->expires <= time(nullptr)) {
+			// Database was changed or the entry expired.
+			used -= entry->size;
+			index.erase(it);
+			entries.erase(entry);
+			return nullptr;
+		}
+
+		entries.splice(entries.begin(),entries,entry);
+		return &(*entry);
+
+	}
+
+	void SQL::Cache::store(Entry &&entry) {
+
+		if(entry.size > limits.size) {
+			debug("Response is too large to cache (",entry.size," bytes)");
+			return;
+		}
+
+		entry.expires = time(nullptr) + limits.ttl;
+
+		lock_guard<mutex> lock(guard);
+
+		auto it = index.find(entry.key);
+		if(it != index.end()) {
+			used -= it->second->size;
+			entries.erase(it->second);
+			index.erase(it);
+		}
+
+		// Evict the least recently used entries.
+		while(!entries.empty() && (entries.size() >= limits.entries || (used + entry.size) > limits.size)) {
+			used -= entries.back().size;
+			index.erase(entries.back().key);
+			entries.pop_back();
+		}
+
+		used += entry.size;
+		entries.push_front(std::move(entry));
+		index[entries.front().key] = entries.begin();
+
+	}
+
+	bool SQL::Cache::get(const std::string &key, unsigned long long generation, Udjat::Value &response) {
+
+		shared_ptr<Udjat::Value> value;
+		{
+			lock_guard<mutex> lock(guard);
+			auto entry = find(key,generation);
+			if(!(entry && entry->value)) {
+				return false;
+			}
+			value = entry->value;
+		}
+
+		response.set(*value);
+		return true;
+
+	}
+
+	bool SQL::Cache::get(const std::string &key, unsigned long long generation, Udjat::Response::Table &response) {
+
+		shared_ptr<Rows> rows;
+		{
+			lock_guard<mutex> lock(guard);
+			auto entry = find(key,generation);
+			if(!(entry && entry->rows)) {
+				return false;
+			}
+			rows = entry->rows;
+		}
+
+		rows->replay(response);
+		return true;
+
+	}
+
+	void SQL::Cache::put(const std::string &key, unsigned long long generation, const Udjat::Value &response) {
+
+		Entry entry;
+		entry.key = key;
+		entry.generation = generation;
+		entry.value = Udjat::Value::ObjectFactory();
+		entry.value->set(response);
+		entry.size = key.size() + size_of(*entry.value);
+
+		store(std::move(entry));
+
+	}
+
+	void SQL::Cache::put(const std::string &key, unsigned long long generation, std::shared_ptr<Rows> rows) {
+
+		Entry entry;
+		entry.key = key;
+		entry.generation = generation;
+		entry.size = key.size() + rows->size();
+		entry.rows = rows;
+
+		store(std::move(entry));
+
+	}
+
+ }
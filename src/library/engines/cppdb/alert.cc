@@ -29,6 +29,9 @@
  #include <udjat/alert/sql.h>
  #include <udjat/tools/value.h>
  #include <private/cppdb.h>
+ #include <private/writer.h>
+ #include <private/plan.h>
+ #include <functional>
  #include <memory>
  #include <cppdb/frontend.h>
  #include <unistd.h>
@@ -37,117 +40,194 @@
 
  namespace Udjat {
 
-	std::shared_ptr<Udjat::Alert::Activation> SQL::Alert::ActivationFactory() const {
+	/// @brief Queued activation, runs its scripts on the writer transaction.
+	using Job = std::function<void(cppdb::session &session, SQL::Statistics::Probe &probe)>;
 
-		/// @brief SQL based alert activation.
-		class Activation : public Udjat::Alert::Activation {
-		private:
+	static SQL::Writers<Job> & writers() {
 
-			const char *dburl;
+		static SQL::Writers<Job> instance{[](const char *dburl, std::vector<Job> &jobs){
 
-			struct Script {
+			// One transaction for every flush, a savepoint for each activation.
+			cppdb::session session{dburl};
+			SQL::Transaction guard{session,dburl,SQL::Script::Immediate};
 
-				const char *text;
+			SQL::QueryPlan plan{session};
+			SQL::Statistics::Probe probe{&plan};
 
-				struct Parameter {
-					const char *name;
-					string value;
-					bool valid = false;
+			for(auto &job : jobs) {
 
-					Parameter(const char *n) : name{n} {
-					}
+				session.create_statement("SAVEPOINT udjat_alert").exec();
+				try {
 
-				};
+					job(session,probe);
+					session.create_statement("RELEASE SAVEPOINT udjat_alert").exec();
 
-				std::vector<Parameter> parameters;
+				} catch(const std::exception &e) {
+
+					Logger::String{"Queued activation has failed: ",e.what()}.warning("alerts");
+					session.create_statement("ROLLBACK TO SAVEPOINT udjat_alert").exec();
+					session.create_statement("RELEASE SAVEPOINT udjat_alert").exec();
 
-				Script(const SQL::Statement &script) : text{script.text} {
-					for(const auto &parm : script.parameter_names) {
-						parameters.emplace_back(parm);
-					}
 				}
 
-			};
+			}
 
-			std::vector<Script> scripts;
+			guard.commit();
 
-			/// @brief Script results.
-			std::shared_ptr<Value> results;
+		}};
 
-		public:
-			Activation(const Abstract::Alert *alert, const SQL::Script &statement)
-				: Udjat::Alert::Activation{alert}, dburl{statement.dbconn()}, results{Udjat::Value::ObjectFactory()} {
+		return instance;
 
-				for(const auto &from : statement) {
-					scripts.emplace_back(from);
-				}
+	}
 
-			}
+	void SQL::Writer::setup(const char *dburl, const XML::Node &node) {
+		writers().setup(dburl,node);
+	}
 
-			void emit() override {
+	void SQL::Writer::getProperties(Udjat::Value &value) {
+		writers().getProperties(value);
+	}
 
-				if(Logger::enabled(Logger::Trace)) {
-					Logger::String{"Emitting alert"}.trace(name.c_str());
-				}
+	void SQL::Writer::shutdown() {
+		writers().shutdown();
+	}
 
-				// Execute scripts
-				{
-					cppdb::session session{dburl};
-					cppdb::transaction guard(session);
+	std::shared_ptr<Udjat::Alert::Activation> SQL::Alert::ActivationFactory() const {
 
-					for(auto &script : scripts) {
+		/// @brief SQL based alert activation.
+		class Activation : public Udjat::Alert::Activation {
+		private:
 
-						if(Logger::enabled(Logger::Debug)) {
-							Logger::String{script.text}.write(Logger::Debug,name.c_str());
-						}
+			/// @brief The compiled script, shared with the alert.
+			std::shared_ptr<const SQL::Plan> plan;
+
+			/// @brief True to queue on the database writer.
+			bool async;
+
+			/// @brief Parameter values, from the plan pool.
+			std::shared_ptr<SQL::Plan::Slots> slots;
+
+			/// @brief Script results, shared with the queued runs.
+			std::shared_ptr<SQL::Results> results;
+
+		public:
+			Activation(const Abstract::Alert *alert, const std::shared_ptr<const SQL::Plan> &p, bool a)
+				: Udjat::Alert::Activation{alert}, plan{p}, async{a}, slots{p->acquire()}, results{std::make_shared<SQL::Results>()} {
+			}
+
+			/// @brief Run scripts on session.
+			static void write(cppdb::session &session, SQL::Statistics::Probe &probe, const SQL::Plan &plan, const SQL::Plan::Slots &slots, Udjat::Value &results, const char *name) {
+
+				for(const auto &script : plan) {
+
+					if(Logger::enabled(Logger::Debug)) {
+						Logger::String{script.text}.write(Logger::Debug,name);
+					}
+
+					probe.start(script.text,script.threshold,script.record);
+					try {
 
 						auto stmt = session.create_statement(script.text);
-						for(auto &parameter : script.parameters) {
-							string rvalue;
-							if(results->getProperty(parameter.name,rvalue)) {
-								debug(parameter.name,"= '",parameter.value,"' (from result)");
-								stmt.bind(rvalue);
+						probe.phase(SQL::Statistics::Prepare);
+
+						SQL::Parameter value;
+						for(size_t slot : script.slots) {
+							const SQL::Plan::Slot &parameter = slots[slot];
+							if(value.set(results,plan.name(slot))) {
+								debug(plan.name(slot)," (from result)");
+								SQL::bind(stmt,value);
 							} else if(parameter.valid) {
-								debug(parameter.name,"= '",parameter.value,"' (from parameters)");
-								stmt.bind(parameter.value);
+								debug(plan.name(slot)," (from parameters)");
+								SQL::bind(stmt,parameter.value);
 							} else {
-								throw runtime_error(Logger::String{"Required parameter '",parameter.name,"' is missing"});
+								throw runtime_error(Logger::String{"Required parameter '",plan.name(slot),"' is missing"});
 							}
 						}
+						probe.phase(SQL::Statistics::Bind);
 
-						if(strncasecmp(script.text,"select",6)) {
+						if(!script.rows()) {
 
-							// Not a select, just execute.
+							// Doesn't return rows, just execute.
 							stmt.exec();
+							probe.phase(SQL::Statistics::Step);
 
 						} else {
 
-							// It's a select, store results.
+							// Returns rows, store results.
 							auto row = stmt.row();
+							probe.phase(SQL::Statistics::Step);
+
 							for(int col = 0; col < row.cols();col++) {
 								string val;
 								row.fetch(col,val);
-								(*results)[row.name(col).c_str()] = val.c_str();
+								results[row.name(col).c_str()] = val.c_str();
+							}
+
+							if(!row.empty()) {
+								probe.phase(SQL::Statistics::Fetch);
+								probe.row();
 							}
 
 						}
 
-					}
+					} catch(...) {
 
-					guard.commit();
+						probe.finish(true);
+						throw;
+
+					}
+					probe.finish();
 
 				}
 
 			}
 
-			Udjat::Alert::Activation & set(const Abstract::Object &object) override {
+			void emit() override {
+
+				if(Logger::enabled(Logger::Trace)) {
+					Logger::String{"Emitting alert"}.trace(name.c_str());
+				}
+
+				if(async) {
 
-				for(auto &script : scripts) {
-					for(auto &parameter : script.parameters) {
-						parameter.valid = parameter.valid || object.getProperty(parameter.name,parameter.value);
+					// Queue a copy of the values, the writer merges the activations in one transaction.
+					auto values = plan->acquire();
+					*values = *slots;
+
+					bool queued = writers()[plan->dbconn()].push([plan = this->plan, values, results = this->results, name = this->name](cppdb::session &session, SQL::Statistics::Probe &probe) {
+						auto response = results->get();
+						write(session,probe,*plan,*values,*response,name.c_str());
+						results->publish(response);
+					});
+
+					if(!queued) {
+						Logger::String{"Alert writer is full, activation was dropped"}.warning(name.c_str());
 					}
+
+					return;
+
+				}
+
+				// Execute scripts
+				{
+					cppdb::session session{plan->dbconn()};
+					SQL::Transaction guard{session,plan->dbconn(),plan->transaction(),plan->readonly()};
+
+					SQL::QueryPlan query{session};
+					SQL::Statistics::Probe probe{&query};
+
+					auto response = results->get();
+					write(session,probe,*plan,*slots,*response,name.c_str());
+
+					guard.commit();
+					results->publish(response);
+
 				}
 
+			}
+
+			Udjat::Alert::Activation & set(const Abstract::Object &object) override {
+				plan->set(*slots,object);
 				return *this;
 			}
 
@@ -158,7 +238,7 @@
 
 		};
 
-		return make_shared<Activation>(this,script);
+		return make_shared<Activation>(this,plan,async);
 
 	}
 
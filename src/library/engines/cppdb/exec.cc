@@ -27,69 +27,229 @@
  #include <udjat/tools/value.h>
  #include <cppdb/frontend.h>
  #include <private/cppdb.h>
+ #include <private/parameter.h>
+ #include <private/cache.h>
  #include <string>
+ #include <functional>
 
  using namespace std;
 
  namespace Udjat {
 
-	void SQL::bind(const SQL::Statement &script, cppdb::statement &stmt, const Abstract::Object &request, Udjat::Value &response) {
+	void SQL::bind(cppdb::statement &stmt, const Parameter &parameter) {
 
-		for(const char *name : script.parameter_names) {
+		switch(parameter.type) {
+		case Parameter::Null:
+			stmt.bind_null();
+			break;
 
-			string value;
+		case Parameter::Integer:
+			stmt.bind(parameter.integer);
+			break;
 
-			if(request.getProperty(name,value)) {
+		case Parameter::Real:
+			stmt.bind(parameter.real);
+			break;
 
-				debug("value(",name,")='",value,"' (from request)");
-				stmt.bind(value);
+		case Parameter::Text:
+			stmt.bind(parameter.text);
+			break;
 
-			} else if(response.getProperty(name,value)) {
+		}
 
-				debug("value(",name,")='",value,"' (from response)");
-				stmt.bind(value);
+	}
 
-			} else {
+	void SQL::bind(const SQL::Statement &script, cppdb::statement &stmt, const Abstract::Object &request, Udjat::Value &response) {
 
-				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+		Parameter parameter;
+		for(const char *name : script.parameter_names) {
 
+			if(!parameter.set(request,response,name)) {
+				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
 			}
 
+			debug("value(",name,") type ",(int) parameter.type);
+			bind(stmt,parameter);
+
 		}
 
 	}
 
+	void SQL::get(cppdb::result &res, Udjat::Value &response) {
+		for(int col = 0; col < res.cols();col++) {
+			string val;
+			res.fetch(col,val);
+			debug(res.name(col).c_str(),"='",val.c_str(),"'");
+			response[res.name(col).c_str()] = val.c_str();
+		}
+	}
+
 	void SQL::parse_result(cppdb::result &res, Udjat::Value &response) {
 		if(!res.empty()) {
 			// Got result update response;
 			debug("Got response from SQL query");
-			for(int col = 0; col < res.cols();col++) {
-				string val;
-				res.fetch(col,val);
-				debug(res.name(col).c_str(),"='",val.c_str(),"'");
-				response[res.name(col).c_str()] = val.c_str();
+			get(res,response);
+		}
+	}
+
+	void SQL::fetch(cppdb::statement &stmt, const SQL::Script &script, Udjat::Value &response, Statistics::Probe &probe) {
+
+		const char *name = script.result_set();
+		if(!(name && *name)) {
+			// Single row mode.
+			auto res = stmt.row();
+			probe.phase(Statistics::Step);
+			if(!res.empty()) {
+				parse_result(res,response);
+				probe.phase(Statistics::Fetch);
+				probe.row();
+			}
+			return;
+		}
+
+		// Store all rows on the result set.
+		Udjat::Value &rows = response[name];
+		if(rows.isNull()) {
+			rows.reset(Udjat::Value::Array);
+		}
+
+		size_t max = script.max_rows();
+		size_t count = 0;
+
+		auto res = stmt.query();
+		probe.phase(Statistics::Step);
+
+		while((!max || count < max) && res.next()) {
+			probe.phase(Statistics::Step);
+			get(res,rows.append(Udjat::Value::Object));
+			probe.phase(Statistics::Fetch);
+			probe.row();
+			count++;
+		}
+
+		debug(count," row(s) stored on '",name,"'");
+
+	}
+
+	std::string SQL::QueryPlan::explain(const char *text) {
+
+		// The explain syntax depends on the driver.
+		string sql{session.driver() == "sqlite3" ? "EXPLAIN QUERY PLAN " : "EXPLAIN "};
+		sql += text;
+
+		string plan;
+		auto result = session.create_statement(sql).query();
+		while(result.next()) {
+
+			if(!plan.empty()) {
+				plan += "; ";
+			}
+
+			for(int col = 0; col < result.cols(); col++) {
+				string value;
+				if(result.fetch(col,value) && !value.empty()) {
+					if(col) {
+						plan += " ";
+					}
+					plan += value;
+				}
+			}
+
+		}
+
+		return plan;
+
+	}
+
+	SQL::Transaction::Transaction(cppdb::session &s, const char *d, SQL::Script::Transaction mode, bool r) : session{s}, dburl{d}, readonly{r} {
+
+		switch(mode) {
+		case SQL::Script::NoTransaction:
+			return;
+
+		case SQL::Script::Deferred:
+			session.begin();
+			break;
+
+		case SQL::Script::Immediate:
+		case SQL::Script::Exclusive:
+			if(session.driver() == "sqlite3") {
+				// Get the locks up front, other drivers have no equivalent.
+				session.create_statement(mode == SQL::Script::Immediate ? "BEGIN IMMEDIATE" : "BEGIN EXCLUSIVE").exec();
+			} else {
+				session.begin();
+			}
+			break;
+
+		}
+
+		active = true;
+
+	}
+
+	SQL::Transaction::Transaction(cppdb::session &s, const SQL::Script &script) : Transaction{s,script.dbconn(),script.transaction(),script.readonly()} {
+	}
+
+	SQL::Transaction::~Transaction() {
+		if(active) {
+			try {
+				session.rollback();
+			} catch(const std::exception &e) {
+				Logger::String{"Rollback has failed: ",e.what()}.error("sql");
 			}
 		}
 	}
 
-	void SQL::exec(cppdb::session &session, const std::vector<SQL::Statement> &scripts, const Abstract::Object &request, Udjat::Value &response) {
+	void SQL::Transaction::commit() {
+
+		if(active) {
+			session.commit();
+			active = false;
+		}
+
+		if(!readonly) {
+			changed(dburl);
+		}
+
+	}
+
+	void SQL::exec(cppdb::session &session, const SQL::Script &script, const Abstract::Object &request, Udjat::Value &response) {
 
 		debug(__FUNCTION__);
 
-		for(auto &script : scripts) {
-			if(script.text && *script.text) {
+		QueryPlan plan{session};
+		Statistics::Probe probe{&plan};
+
+		for(auto &statement : script) {
+			if(statement.text && *statement.text) {
 				if(Logger::enabled(Logger::Trace)) {
-					Logger::String{script.text}.trace("sql");
+					Logger::String{statement.text}.trace("sql");
 				}
-				auto stmt = session.create_statement(script.text);
-				bind(script,stmt,request,response);
-
-				if(strcasestr(script.text,"select")) {
-					auto res = stmt.row();
-					parse_result(res,response);
-				} else {
-					stmt.exec();
+
+				probe.start(statement);
+				try {
+
+					auto stmt = session.create_statement(statement.text);
+					probe.phase(Statistics::Prepare);
+
+					bind(statement,stmt,request,response);
+					probe.phase(Statistics::Bind);
+
+					if(statement.rows()) {
+						fetch(stmt,script,response,probe);
+					} else {
+						stmt.exec();
+						probe.phase(Statistics::Step);
+					}
+
+				} catch(...) {
+
+					probe.finish(true);
+					throw;
+
 				}
+				probe.finish();
+
 			}
 		}
 	}
@@ -101,9 +261,9 @@
 		auto values = Udjat::Value::ObjectFactory();
 
 		cppdb::session session{dburl};
-		cppdb::transaction guard(session);
+		SQL::Transaction guard{session,*this};
 
-		SQL::exec(session,scripts,request,*values);
+		SQL::exec(session,*this,request,*values);
 
 		guard.commit();
 
@@ -114,35 +274,49 @@
 		debug(__FUNCTION__);
 
 		cppdb::session session{dburl};
-		cppdb::transaction guard(session);
+		SQL::Transaction guard{session,*this};
+
+		QueryPlan plan{session};
+		Statistics::Probe probe{&plan};
 
 		for(auto &script : scripts) {
 
 			if(script.text && *script.text) {
-				auto stmt = session.create_statement(script.text);
 
-				for(const char *name : script.parameter_names) {
+				probe.start(script);
+				try {
 
-					string value;
+					auto stmt = session.create_statement(script.text);
+					probe.phase(Statistics::Prepare);
 
-					if(response->getProperty(name,value)) {
+					Parameter parameter;
+					for(const char *name : script.parameter_names) {
 
-						debug("value(",name,")='",value,"' (from response)");
-						stmt.bind(value);
+						if(!parameter.set(*response,name)) {
+							throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+						}
 
-					} else {
+						debug("value(",name,") type ",(int) parameter.type);
+						bind(stmt,parameter);
 
-						throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+					}
+					probe.phase(Statistics::Bind);
 
+					if(script.rows()) {
+						fetch(stmt,*this,*response,probe);
+					} else {
+						stmt.exec();
+						probe.phase(Statistics::Step);
 					}
-				}
 
-				if(strcasestr(script.text,"select")) {
-					auto res = stmt.row();
-					parse_result(res,*response);
-				} else {
-					stmt.exec();
+				} catch(...) {
+
+					probe.finish(true);
+					throw;
+
 				}
+				probe.finish();
+
 			}
 		}
 
@@ -155,9 +329,9 @@
 		debug(__FUNCTION__);
 
 		cppdb::session session{dburl};
-		cppdb::transaction guard(session);
+		SQL::Transaction guard{session,*this};
 
-		SQL::exec(session,scripts,request,response);
+		SQL::exec(session,*this,request,response);
 
 		guard.commit();
 
@@ -168,9 +342,9 @@
 		debug(__FUNCTION__,"::Value start");
 
 		cppdb::session session{dburl};
-		cppdb::transaction guard(session);
+		SQL::Transaction guard{session,*this};
 
-		SQL::exec(session,scripts,request,response);
+		SQL::exec(session,*this,request,response);
 
 		guard.commit();
 
@@ -178,79 +352,109 @@
 
 	}
 
-	void SQL::Script::exec(const Request &request, Udjat::Response::Table &response) const {
+	/// @brief Run script, send rows to table.
+	template <typename T>
+	static void table(const SQL::Script &scripts, const Request &request, T &response) {
 
 		debug(__FUNCTION__,"::Table start");
 
-		cppdb::session session{dburl};
-		cppdb::transaction guard(session);
+		cppdb::session session{scripts.dbconn()};
+		SQL::Transaction guard{session,scripts};
+
+		SQL::QueryPlan plan{session};
+		SQL::Statistics::Probe probe{&plan};
 
 		for(const auto &script : scripts) {
 
-			if(strcasestr(script.text,"select")) {
+			if(script.rows()) {
 
 				debug(__FUNCTION__,"('",script.text,"')");
 
-				// It's a select, get report
-				auto stmt = session.create_statement(script.text);
-				for(const char *name : scripts[0].parameter_names) {
+				probe.start(script);
+				try {
 
-					string value;
-					if(request.getProperty(name,value)) {
+					// It's a select, get report
+					auto stmt = session.create_statement(script.text);
+					probe.phase(SQL::Statistics::Prepare);
 
-						debug("value(",name,")='",value,"' (from request)");
-						stmt.bind(value);
+					SQL::Parameter parameter;
+					for(const char *name : script.parameter_names) {
 
-					} else {
+						if(!parameter.set(request,name)) {
+							throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+						}
 
-						throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+						debug("value(",name,")='",parameter.text,"' (from request)");
+						bind(stmt,parameter);
 
 					}
+					probe.phase(SQL::Statistics::Bind);
 
-				}
+					auto result = stmt.query();
+					bool found = result.next();
+					probe.phase(SQL::Statistics::Step);
+
+					if(found) {
 
-				auto result = stmt.row();
+						// Get first line and column names.
+						int numcols = result.cols();
+						std::vector<string> values;
+						std::vector<string> colnames;
 
-				if(!result.empty()) {
+						for(int col = 0; col < numcols;col++) {
+							string val;
+							result.fetch(col,val);
+							values.push_back(val);
+							colnames.push_back(result.name(col));
+						}
 
-					// Get first line and column names.
-					int numcols = result.cols();
-					std::vector<string> values;
-					std::vector<string> colnames;
+						// Start report...
+						response.start(colnames);
 
-					for(int col = 0; col < numcols;col++) {
-						string val;
-						result.fetch(col,val);
-						values.push_back(val);
-						colnames.push_back(result.name(col));
-					}
+						// ...and store first line
+						for(auto &value : values) {
+							response << value;
+						}
+						probe.phase(SQL::Statistics::Fetch);
+						probe.row();
 
-					// Start report...
-					response.start(colnames);
+						size_t rows = 1;
 
-					// ...and store first line
-					for(auto &value : values) {
-						response << value;
-					}
+						// Get other lines.
+						size_t max = scripts.max_rows();
+						while(!max || rows < max) {
 
-					size_t rows = 1;
+							found = result.next();
+							probe.phase(SQL::Statistics::Step);
+
+							if(!found) {
+								break;
+							}
+
+							rows++;
+							for(int col = 0; col < numcols;col++) {
+								string value;
+								result.fetch(col,value);
+								response << value;
+							}
+							probe.phase(SQL::Statistics::Fetch);
+							probe.row();
 
-					// Get other lines.
-					while(result.next()) {
-						rows++;
-						for(int col = 0; col < numcols;col++) {
-							string value;
-							result.fetch(col,value);
-							response << value;
 						}
+						response.count(rows);
 
+					} else {
+						debug("Empty response");
+						response.count(0);
 					}
-					response.count(rows);
 
-				} else {
-					debug("Empty response");
-					response.count(0);
+				} catch(...) {
+
+					probe.finish(true);
+					throw;
+
 				}
+				probe.finish();
 
 			}
 #ifdef DEBUG
@@ -263,7 +467,225 @@
 
 		guard.commit();
 
-		debug(__FUNCTION__,"::Value ends");
+		debug(__FUNCTION__,"::Table ends");
+	}
+
+	void SQL::Script::exec(const Request &request, Udjat::Response::Table &response) const {
+		table(*this,request,response);
+	}
+
+	/// @brief Run single statement script, get one column from the first row.
+	template <typename T>
+	static bool get(const SQL::Script &script, const Udjat::Object &request, const char *name, T &value) {
+
+		if(script.size() != 1) {
+			throw runtime_error("Single value query requires a single statement script");
+		}
+
+		const SQL::Statement &statement = *script.begin();
+		bool found = false;
+
+		cppdb::session session{script.dbconn()};
+		SQL::Transaction guard{session,script};
+
+		SQL::QueryPlan plan{session};
+		SQL::Statistics::Probe probe{&plan};
+
+		probe.start(statement);
+		try {
+
+			// Prepared statements are cached by the cppdb connection pool.
+			auto stmt = session.create_prepared_statement(statement.text);
+			probe.phase(SQL::Statistics::Prepare);
+
+			SQL::Parameter parameter;
+			for(const char *parameter_name : statement.parameter_names) {
+
+				if(!parameter.set(request,parameter_name)) {
+					throw runtime_error(Logger::String{"Required property '",parameter_name,"' is missing"});
+				}
+
+				bind(stmt,parameter);
+
+			}
+			probe.phase(SQL::Statistics::Bind);
+
+			auto result = stmt.query();
+			bool row = result.next();
+			probe.phase(SQL::Statistics::Step);
+
+			if(row) {
+
+				int col = result.find_column(name);
+				if(col < 0) {
+					Logger::String{"Query has no column '",name,"'"}.warning("sql");
+				} else if(!result.is_null(col)) {
+					result.fetch(col,value);
+					found = true;
+				}
+				probe.phase(SQL::Statistics::Fetch);
+				probe.row();
+
+			}
+
+		} catch(...) {
+
+			probe.finish(true);
+			throw;
+
+		}
+		probe.finish();
+
+		guard.commit();
+
+		return found;
+
+	}
+
+	bool SQL::Script::get(const Udjat::Object &request, const char *column, long long &value) const {
+		return Udjat::get(*this,request,column,value);
+	}
+
+	bool SQL::Script::get(const Udjat::Object &request, const char *column, double &value) const {
+		return Udjat::get(*this,request,column,value);
+	}
+
+	bool SQL::Script::get(const Udjat::Object &request, const char *column, std::string &value) const {
+		return Udjat::get(*this,request,column,value);
+	}
+
+	void SQL::Script::exec(const Request &request, SQL::Rows &response) const {
+		table(*this,request,response);
+	}
+
+	/// @brief Run script for every row inside one transaction, with a savepoint for each one.
+	/// @param bind Bind the statement parameters for a row.
+	static std::vector<SQL::Script::Result> batch(const SQL::Script &script, size_t count, const std::function<void(size_t row, const SQL::Statement &statement, cppdb::statement &stmt, SQL::Script::Result &result)> &bind) {
+
+		std::vector<SQL::Script::Result> results(count);
+
+		cppdb::session session{script.dbconn()};
+
+		// The batch is always one transaction.
+		SQL::Transaction guard{session,script.dbconn(),(script.transaction() == SQL::Script::NoTransaction ? SQL::Script::Deferred : script.transaction()),script.readonly()};
+
+		SQL::QueryPlan plan{session};
+		SQL::Statistics::Probe probe{&plan};
+
+		// Prepare once, every row just rebinds the parameters.
+		std::vector<cppdb::statement> statements;
+		for(const auto &statement : script) {
+			if(statement.text && *statement.text) {
+				statements.push_back(session.create_prepared_statement(statement.text));
+			} else {
+				statements.emplace_back();
+			}
+		}
+
+		for(size_t row = 0; row < count; row++) {
+
+			SQL::Script::Result &result = results[row];
+
+			session.create_statement("SAVEPOINT udjat_batch_row").exec();
+			try {
+
+				size_t index = 0;
+				for(const auto &statement : script) {
+
+					cppdb::statement &stmt = statements[index++];
+					if(!(statement.text && *statement.text)) {
+						continue;
+					}
+
+					probe.start(statement);
+					try {
+
+						stmt.reset();
+						bind(row,statement,stmt,result);
+						probe.phase(SQL::Statistics::Bind);
+
+						if(statement.rows()) {
+							SQL::fetch(stmt,script,*result.response,probe);
+						} else {
+							stmt.exec();
+							probe.phase(SQL::Statistics::Step);
+						}
+
+					} catch(...) {
+
+						probe.finish(true);
+						throw;
+
+					}
+					probe.finish();
+
+				}
+
+				session.create_statement("RELEASE SAVEPOINT udjat_batch_row").exec();
+
+			} catch(const std::exception &e) {
+
+				result.error = e.what();
+				Logger::String{"Batch row ",row," has failed: ",e.what()}.warning("sql");
+
+				session.create_statement("ROLLBACK TO SAVEPOINT udjat_batch_row").exec();
+				session.create_statement("RELEASE SAVEPOINT udjat_batch_row").exec();
+
+			}
+
+		}
+
+		guard.commit();
+
+		return results;
+
+	}
+
+	std::vector<SQL::Script::Result> SQL::Script::batch(const std::vector<std::shared_ptr<Udjat::Value>> &values) const {
+
+		debug(__FUNCTION__," ",values.size()," row(s)");
+
+		return ::Udjat::batch(*this,values.size(),[&](size_t row, const SQL::Statement &statement, cppdb::statement &stmt, Result &result){
+
+			result.response = values[row];
+
+			Parameter parameter;
+			for(const char *name : statement.parameter_names) {
+				if(!parameter.set(*result.response,name)) {
+					throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+				}
+				SQL::bind(stmt,parameter);
+			}
+
+		});
+
+	}
+
+	std::vector<SQL::Script::Result> SQL::Script::batch(const Udjat::Object &request, const std::vector<std::shared_ptr<Udjat::Value>> &values) const {
+
+		debug(__FUNCTION__," ",values.size()," row(s)");
+
+		return ::Udjat::batch(*this,values.size(),[&](size_t row, const SQL::Statement &statement, cppdb::statement &stmt, Result &result){
+			result.response = values[row];
+			SQL::bind(statement,stmt,request,*result.response);
+		});
+
+	}
+
+	std::vector<SQL::Script::Result> SQL::Script::batch(const std::vector<const Udjat::Object *> &requests) const {
+
+		debug(__FUNCTION__," ",requests.size()," row(s)");
+
+		return ::Udjat::batch(*this,requests.size(),[&](size_t row, const SQL::Statement &statement, cppdb::statement &stmt, Result &result){
+
+			if(!result.response) {
+				result.response = Udjat::Value::ObjectFactory();
+			}
+
+			SQL::bind(statement,stmt,*requests[row],*result.response);
+
+		});
+
 	}
 
  }
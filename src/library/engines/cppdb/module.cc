@@ -25,10 +25,49 @@
  #include <udjat/tools/intl.h>
  #include <private/module.h>
  #include <udjat/module/info.h>
+ #include <udjat/tools/value.h>
+ #include <private/cppdb.h>
+ #include <private/cache.h>
+ #include <private/watcher.h>
+ #include <mutex>
+ #include <unordered_map>
+
+ using namespace std;
 
  namespace Udjat {
 
 	const ModuleInfo SQL::module_info{"cppdb", "CPPDB SQL Module"};
 
+	/// @brief Database generations, indexed by the interned connection string.
+	/// @note There's no portable way to detect changes from other processes, only writes from this one are counted.
+	static struct {
+		mutex guard;
+		unordered_map<const char *, unsigned long long> generations;
+	} registry;
+
+	Udjat::Value & SQL::getProperties(Udjat::Value &properties) {
+		return properties;
+	}
+
+	void SQL::shutdown() {
+	}
+
+	void SQL::changed(const char *dburl) {
+
+		{
+			lock_guard<mutex> lock(registry.guard);
+			registry.generations[dburl]++;
+		}
+
+		// The changed tables are unknown, notify every subscription on the database.
+		SQL::Watcher::changed(dburl);
+
+	}
+
+	unsigned long long SQL::generation(const char *dburl) {
+		lock_guard<mutex> lock(registry.guard);
+		return registry.generations[dburl];
+	}
+
  }
 
@@ -33,55 +33,118 @@
  #include <udjat/tools/sql/script.h>
  #include <sqlite3.h>
  #include <private/sqlite.h>
+ #include <private/parameter.h>
+ #include <private/writer.h>
+ #include <private/plan.h>
+ #include <functional>
 
  using namespace std;
 
  namespace Udjat {
 
+	/// @brief Queued activation, runs its statements on the writer transaction.
+	using Job = std::function<void(SQL::Session &session)>;
+
+	static SQL::Writers<Job> & writers() {
+
+		static SQL::Writers<Job> instance{[](const char *dburl, std::vector<Job> &jobs){
+
+			// One transaction for every flush, a savepoint for each activation.
+			SQL::Session session{dburl};
+			session.batch(SQL::Script::Immediate,jobs.size(),[&session,&jobs](size_t row, SQL::Script::Result &){
+				jobs[row](session);
+			});
+
+		}};
+
+		return instance;
+
+	}
+
+	void SQL::Writer::setup(const char *dburl, const XML::Node &node) {
+		writers().setup(dburl,node);
+	}
+
+	void SQL::Writer::getProperties(Udjat::Value &value) {
+		writers().getProperties(value);
+	}
+
+	void SQL::Writer::shutdown() {
+		writers().shutdown();
+	}
+
 	std::shared_ptr<Udjat::Alert::Activation> SQL::Alert::ActivationFactory() const {
 
 		/// @brief SQL based alert activation.
 		class Activation : public Udjat::Alert::Activation {
 		private:
 
-			const char *dburl;
+			/// @brief The compiled script, shared with the alert.
+			std::shared_ptr<const SQL::Plan> plan;
 
-			struct Statement {
+			/// @brief True to queue on the database writer.
+			bool async;
 
-				const char *text;
+			/// @brief Parameter values, from the plan pool.
+			std::shared_ptr<SQL::Plan::Slots> slots;
 
-				struct Parameter {
-					const char *name;
-					string value;
-					bool valid = false;
+			/// @brief Script results, shared with the queued runs.
+			std::shared_ptr<SQL::Results> results;
 
-					Parameter(const char *n) : name{n} {
-					}
+		public:
+			Activation(const Abstract::Alert *alert, const std::shared_ptr<const SQL::Plan> &p, bool a)
+				: Udjat::Alert::Activation{alert}, plan{p}, async{a}, slots{p->acquire()}, results{std::make_shared<SQL::Results>()} {
+			}
 
-				};
+			/// @brief Run statements on session.
+			static void write(SQL::Session &session, const SQL::Plan &plan, const SQL::Plan::Slots &slots, Udjat::Value &results, const char *name) {
 
-				std::vector<Parameter> parameters;
+				for(const auto &statement : plan) {
 
-				Statement(const SQL::Statement &script) : text{script.text} {
-					for(const auto &parm : script.parameter_names) {
-						parameters.emplace_back(parm);
+					if(Logger::enabled(Logger::Debug)) {
+						Logger::String{statement.text}.write(Logger::Debug,name);
 					}
-				}
 
-			};
+					// Values from results, kept until the statement reset.
+					std::vector<SQL::Parameter> values(statement.slots.size());
+
+					session.probe.start(statement.text,statement.threshold,statement.record);
+					try {
+
+						auto stmt = session.statement(statement.text);
+						session.probe.phase(SQL::Statistics::Prepare);
+
+						SQL::Session::Lock lock{session,stmt};
+						session.probe.resume();
+
+						int column = 1;
+						for(size_t slot : statement.slots) {
+							SQL::Parameter &value = values[column-1];
+							const SQL::Plan::Slot &parameter = slots[slot];
+							if(value.set(results,plan.name(slot))) {
+								debug(plan.name(slot)," (from result)");
+								session.bind(stmt,column,value);
+							} else if(parameter.valid) {
+								debug(plan.name(slot)," (from parameters)");
+								session.bind(stmt,column,parameter.value);
+							} else {
+								throw runtime_error(Logger::String{"Required parameter '",plan.name(slot),"' is missing"});
+							}
+							column++;
+						}
+
+						session.probe.phase(SQL::Statistics::Bind);
 
-			/// @brief The SQL statements.
-			std::vector<Statement> statements;
+						session.step(stmt, results);
 
-			/// @brief Script results.
-			std::shared_ptr<Value> results;
+					} catch(...) {
 
-		public:
-			Activation(const Abstract::Alert *alert, const SQL::Script &script)
-				: Udjat::Alert::Activation{alert}, dburl{script.dbconn()}, results{Udjat::Value::ObjectFactory()} {
+						session.probe.finish(true);
+						throw;
+
+					}
+					session.probe.finish();
 
-				for(const auto &from : script) {
-					statements.emplace_back(from);
 				}
 
 			}
@@ -92,73 +155,43 @@
 					Logger::String{"Emitting alert"}.trace(name.c_str());
 				}
 
-				// Execute statements
-				{
-					SQL::Session session{dburl};
+				if(async) {
 
-					for(auto &statement : statements) {
+					// Queue a copy of the values, the writer merges the activations in one transaction.
+					auto values = plan->acquire();
+					*values = *slots;
 
-						if(Logger::enabled(Logger::Debug)) {
-							Logger::String{statement.text}.write(Logger::Debug,name.c_str());
-						}
+					bool queued = writers()[plan->dbconn()].push([plan = this->plan, values, results = this->results, name = this->name](SQL::Session &session) {
+						auto response = results->get();
+						write(session,*plan,*values,*response,name.c_str());
+						results->publish(response);
+					});
 
-						auto stmt = session.prepare(statement.text);
-
-						try {
-
-							int column = 1;
-							for(auto &parameter : statement.parameters) {
-								string rvalue;
-								if(results->getProperty(parameter.name,rvalue)) {
-									debug(parameter.name,"= '",parameter.value,"' (from result)");
-									session.check(
-										sqlite3_bind_text(
-											stmt,
-											column,
-											rvalue.c_str(),
-											rvalue.size()+1,
-											SQLITE_TRANSIENT
-										)
-									);
-								} else if(parameter.valid) {
-									debug(parameter.name,"= '",parameter.value,"' (from parameters)");
-									session.check(
-										sqlite3_bind_text(
-											stmt,
-											column,
-											parameter.value.c_str(),
-											parameter.value.size()+1,
-											SQLITE_TRANSIENT
-										)
-									);
-								} else {
-									throw runtime_error(Logger::String{"Required parameter '",parameter.name,"' is missing"});
-								}
-								column++;
-							}
+					if(!queued) {
+						Logger::String{"Alert writer is full, activation was dropped"}.warning(name.c_str());
+					}
 
-							session.step(stmt, *results);
+					return;
 
-						} catch(...) {
-							sqlite3_finalize(stmt);
-							throw;
-						}
-						sqlite3_finalize(stmt);
+				}
 
-					}
+				// Execute statements
+				{
+					SQL::Session session{plan->dbconn()};
+					SQL::Session::Transaction guard{session,plan->transaction(),plan->readonly()};
+
+					auto response = results->get();
+					write(session,*plan,*slots,*response,name.c_str());
+
+					guard.commit();
+					results->publish(response);
 
 				}
 
 			}
 
 			Udjat::Alert::Activation & set(const Abstract::Object &object) override {
-
-				for(auto &statement : statements) {
-					for(auto &parameter : statement.parameters) {
-						parameter.valid = parameter.valid || object.getProperty(parameter.name,parameter.value);
-					}
-				}
-
+				plan->set(*slots,object);
 				return *this;
 			}
 
@@ -169,7 +202,7 @@
 
 		};
 
-		return make_shared<Activation>(this,script);
+		return make_shared<Activation>(this,plan,async);
 
 	}
 
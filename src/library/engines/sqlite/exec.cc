@@ -98,28 +98,28 @@
 		debug(__FUNCTION__);
 
 		auto values = Udjat::Value::ObjectFactory();
-		SQL::Session{dburl}.exec(scripts,request,*values);
+		SQL::Session{dburl}.exec(*this,request,*values);
 
 	}
 
 	void SQL::Script::exec(std::shared_ptr<Udjat::Value> response) const {
 
 		debug(__FUNCTION__);
-		SQL::Session{dburl}.exec(scripts,*response);
+		SQL::Session{dburl}.exec(*this,*response);
 
 	}
 
 	void SQL::Script::exec(const Udjat::Object &request, Udjat::Value &response) const {
 
 		debug(__FUNCTION__);
-		SQL::Session{dburl}.exec(scripts,request,response);
+		SQL::Session{dburl}.exec(*this,request,response);
 
 	}
 
 	void SQL::Script::exec(const Request &request, Udjat::Value &response) const {
 
 		debug(__FUNCTION__,"::Value start");
-		SQL::Session{dburl}.exec(scripts,request,response);
+		SQL::Session{dburl}.exec(*this,request,response);
 		debug(__FUNCTION__,"::Value ends");
 
 	}
@@ -127,9 +127,67 @@
 	void SQL::Script::exec(const Request &request, Udjat::Response::Table &response) const {
 
 		debug(__FUNCTION__,"::Table start");
-		SQL::Session{dburl}.exec(scripts,request,response);
+		SQL::Session{dburl}.exec(*this,request,response);
 		debug(__FUNCTION__,"::Table ends");
 	}
 
+	bool SQL::Script::get(const Udjat::Object &request, const char *column, long long &value) const {
+		return SQL::Session{dburl}.get(*this,request,column,[&value](sqlite3_stmt *stmt, int col){
+			value = sqlite3_column_int64(stmt,col);
+		});
+	}
+
+	bool SQL::Script::get(const Udjat::Object &request, const char *column, double &value) const {
+		return SQL::Session{dburl}.get(*this,request,column,[&value](sqlite3_stmt *stmt, int col){
+			value = sqlite3_column_double(stmt,col);
+		});
+	}
+
+	bool SQL::Script::get(const Udjat::Object &request, const char *column, std::string &value) const {
+		return SQL::Session{dburl}.get(*this,request,column,[&value](sqlite3_stmt *stmt, int col){
+			value.assign((const char *) sqlite3_column_text(stmt,col),sqlite3_column_bytes(stmt,col));
+		});
+	}
+
+	void SQL::Script::exec(const Request &request, SQL::Rows &response) const {
+		SQL::Session{dburl}.exec(*this,request,response);
+	}
+
+	std::vector<SQL::Script::Result> SQL::Script::batch(const std::vector<std::shared_ptr<Udjat::Value>> &values) const {
+
+		debug(__FUNCTION__," ",values.size()," row(s)");
+
+		SQL::Session session{dburl};
+		return session.batch(*this,values.size(),[&](size_t row, Result &result){
+			result.response = values[row];
+			session.exec(*this,*result.response);
+		});
+
+	}
+
+	std::vector<SQL::Script::Result> SQL::Script::batch(const Udjat::Object &request, const std::vector<std::shared_ptr<Udjat::Value>> &values) const {
+
+		debug(__FUNCTION__," ",values.size()," row(s)");
+
+		SQL::Session session{dburl};
+		return session.batch(*this,values.size(),[&](size_t row, Result &result){
+			result.response = values[row];
+			session.exec(*this,request,*result.response);
+		});
+
+	}
+
+	std::vector<SQL::Script::Result> SQL::Script::batch(const std::vector<const Udjat::Object *> &requests) const {
+
+		debug(__FUNCTION__," ",requests.size()," row(s)");
+
+		SQL::Session session{dburl};
+		return session.batch(*this,requests.size(),[&](size_t row, Result &result){
+			result.response = Udjat::Value::ObjectFactory();
+			session.exec(*this,*requests[row],*result.response);
+		});
+
+	}
+
  }
 
@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+ /**
+  * @brief Implements the sqlite maintenance agent.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/value.h>
+ #include <private/maintenance.h>
+ #include <private/sqlite.h>
+ #include <sqlite3.h>
+ #include <mutex>
+ #include <shared_mutex>
+ #include <chrono>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Get integer PRAGMA.
+	static long long pragma(sqlite3 *db, const char *sql) {
+
+		sqlite3_stmt *stmt;
+		if(sqlite3_prepare_v2(db,sql,-1,&stmt,NULL) != SQLITE_OK) {
+			throw runtime_error(sqlite3_errmsg(db));
+		}
+
+		long long value = 0;
+		if(sqlite3_step(stmt) == SQLITE_ROW) {
+			value = sqlite3_column_int64(stmt,0);
+		}
+		sqlite3_finalize(stmt);
+
+		return value;
+
+	}
+
+	static void exec(sqlite3 *db, const char *sql) {
+		debug(sql);
+		if(sqlite3_exec(db,sql,NULL,NULL,NULL) != SQLITE_OK) {
+			throw runtime_error(Logger::String{"Error on '",sql,"': ",sqlite3_errmsg(db)});
+		}
+	}
+
+	SQL::Maintenance::Maintenance(const XML::Node &node) : Udjat::Agent<unsigned int>{node}, script{node,"script",true,false} {
+
+		limits.checkpoint = Object::getAttribute(node, "sqlite", "checkpoint-threshold", limits.checkpoint);
+		limits.vacuum = Object::getAttribute(node, "sqlite", "vacuum-threshold", limits.vacuum);
+		limits.analyze = Object::getAttribute(node, "sqlite", "analyze-interval", (unsigned int) limits.analyze);
+
+		SQL::Script::init(node);
+
+	}
+
+	SQL::Maintenance::~Maintenance() {
+	}
+
+	bool SQL::Maintenance::refresh(bool) {
+
+		auto started = chrono::steady_clock::now();
+		time_t now = time(nullptr);
+
+		Pool &pool = Pool::getInstance(script.dbconn());
+
+		int frames = -1;
+		int checkpointed = -1;
+		bool truncated = false;
+		long long free = 0;
+		long long reclaimed = 0;
+		bool analyze = limits.analyze && (analyzed + limits.analyze) <= now;
+
+		Pool::Connection *connection = pool.borrow();
+		try {
+
+			sqlite3 *db = connection->db;
+
+			// Passive checkpoint doesn't block readers or writers, gets the WAL size.
+			// Not in WAL mode, frames and checkpointed are set to -1.
+			int rc = sqlite3_wal_checkpoint_v2(db,NULL,SQLITE_CHECKPOINT_PASSIVE,&frames,&checkpointed);
+			if(rc != SQLITE_OK && rc != SQLITE_BUSY) {
+				throw runtime_error(Logger::String{"Checkpoint has failed: ",sqlite3_errmsg(db)});
+			}
+
+			if(frames > 0 && (unsigned int) frames >= limits.checkpoint) {
+
+				// Keep this process sessions out, truncate waits for readers.
+				unique_lock<shared_mutex> lock(pool.access);
+
+				rc = sqlite3_wal_checkpoint_v2(db,NULL,SQLITE_CHECKPOINT_TRUNCATE,&frames,&checkpointed);
+				if(rc == SQLITE_OK) {
+					truncated = true;
+				} else if(rc == SQLITE_BUSY) {
+					Logger::String{"WAL truncate is busy, will retry on next run"}.warning(name());
+				} else {
+					throw runtime_error(Logger::String{"Checkpoint has failed: ",sqlite3_errmsg(db)});
+				}
+
+			}
+
+			{
+				// Let sqlite decide the tables requiring new statistics, it can run ANALYZE (a write).
+				unique_lock<shared_mutex> lock(pool.access);
+				exec(db,"PRAGMA optimize");
+			}
+
+			if(analyze) {
+				unique_lock<shared_mutex> lock(pool.access);
+				exec(db,"ANALYZE");
+			}
+
+			free = pragma(db,"PRAGMA freelist_count");
+			if(limits.vacuum && free >= (long long) limits.vacuum) {
+
+				// 2 = incremental, the only mode allowing vacuum without rebuilding the database.
+				if(pragma(db,"PRAGMA auto_vacuum") == 2) {
+
+					unique_lock<shared_mutex> lock(pool.access);
+					exec(db,"PRAGMA incremental_vacuum");
+
+					long long after = pragma(db,"PRAGMA freelist_count");
+					reclaimed = free - after;
+					free = after;
+
+					pool.changed();
+
+				} else if(!warned) {
+
+					warned = true;
+					Logger::String{free," free pages on database, vacuum requires 'PRAGMA auto_vacuum=incremental'"}.warning(name());
+
+				}
+
+			}
+
+		} catch(...) {
+
+			pool.release(connection);
+			throw;
+
+		}
+		pool.release(connection);
+
+		// Custom statements, after releasing the connection.
+		if(script.size()) {
+			script.exec(*this);
+		}
+
+		unsigned int elapsed = (unsigned int) chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			if(analyze) {
+				analyzed = now;
+			}
+
+			last.timestamp = now;
+			last.elapsed = elapsed;
+			last.frames = frames;
+			last.checkpointed = checkpointed;
+			last.truncated = truncated;
+			last.free = (unsigned int) free;
+			last.reclaimed = (unsigned int) reclaimed;
+			this->reclaimed += reclaimed;
+		}
+
+		if(Logger::enabled(Logger::Trace)) {
+			Logger::String{
+				"Maintenance took ",elapsed,"ms, wal-frames=",frames," checkpointed=",checkpointed,
+				(truncated ? " (truncated)" : "")," reclaimed=",reclaimed," free=",free
+			}.trace(name());
+		}
+
+		return set((unsigned int) (frames < 0 ? 0 : frames));
+
+	}
+
+	Udjat::Value & SQL::Maintenance::getProperties(Udjat::Value &value) const {
+
+		Udjat::Agent<unsigned int>::getProperties(value);
+
+		lock_guard<mutex> lock(guard);
+
+		value["database"] = script.dbconn();
+		value["last-maintenance"] = (unsigned int) last.timestamp;
+		value["elapsed"] = last.elapsed;
+		value["wal-frames"] = last.frames;
+		value["checkpointed"] = last.checkpointed;
+		value["truncated"] = last.truncated;
+		value["free-pages"] = last.free;
+		value["reclaimed"] = last.reclaimed;
+		value["reclaimed-total"] = (unsigned int) reclaimed;
+		value["last-analyze"] = (unsigned int) analyzed;
+
+		return value;
+
+	}
+
+ }
@@ -26,11 +26,31 @@
  #include <udjat/tools/intl.h>
  #include <private/module.h>
  #include <udjat/module/info.h>
+ #include <udjat/tools/value.h>
  #include <sqlite3.h>
+ #include <private/sqlite.h>
 
  namespace Udjat {
 
 	const ModuleInfo SQL::module_info{"sqlite", "SQLite " SQLITE_VERSION " SQL Module"};
 
+	Udjat::Value & SQL::getProperties(Udjat::Value &properties) {
+
+		Udjat::Value &databases = properties["databases"];
+		Pool::for_each([&databases](const Pool &pool){
+			pool.getProperties(databases.append(Udjat::Value::Object));
+		});
+
+		return properties;
+	}
+
+	void SQL::shutdown() {
+		Pool::shutdown();
+	}
+
+	unsigned long long SQL::generation(const char *dburl) {
+		return Pool::getInstance(dburl).generation();
+	}
+
  }
 
@@ -0,0 +1,653 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements sqlite3 connection pool.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/string.h>
+ #include <private/sqlite.h>
+ #include <private/watcher.h>
+ #include <sqlite3.h>
+ #include <mutex>
+ #include <memory>
+ #include <unordered_map>
+ #include <stdexcept>
+ #include <string>
+ #include <vector>
+ #include <cstdlib>
+ #include <cstring>
+ #include <climits>
+ #include <chrono>
+ #include <strings.h>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Active pools, indexed by the interned database name.
+	static struct {
+		mutex guard;
+		unordered_map<const char *, unique_ptr<SQL::Pool>> pools;
+	} registry;
+
+	/// @brief Run PRAGMA, get its value.
+	/// @param value The new value, empty to just get the current one.
+	static string pragma(sqlite3 *db, const char *name, const std::string &value = "") {
+
+		string sql{"PRAGMA "};
+		sql += name;
+		if(!value.empty()) {
+			sql += "=";
+			sql += value;
+		}
+
+		sqlite3_stmt *stmt;
+		if(sqlite3_prepare_v2(db,sql.c_str(),-1,&stmt,NULL) != SQLITE_OK) {
+			throw runtime_error(Logger::String{"Error on '",sql.c_str(),"': ",sqlite3_errmsg(db)});
+		}
+
+		// Some pragmas (journal_mode, mmap_size) return the effective value when set.
+		string result;
+		int rc = sqlite3_step(stmt);
+		if(rc == SQLITE_ROW) {
+			const char *text = (const char *) sqlite3_column_text(stmt,0);
+			if(text) {
+				result = text;
+			}
+		} else if(rc != SQLITE_DONE) {
+			string message{sqlite3_errmsg(db)};
+			sqlite3_finalize(stmt);
+			throw runtime_error(Logger::String{"Error on '",sql.c_str(),"': ",message.c_str()});
+		}
+		sqlite3_finalize(stmt);
+
+		if(!value.empty() && result.empty()) {
+			return pragma(db,name);
+		}
+
+		return result;
+
+	}
+
+	/// @brief Get name for a numeric PRAGMA value.
+	static string pragma_name(const string &value, const std::vector<const char *> &names) {
+		size_t index = (size_t) atoi(value.c_str());
+		if(value.empty() || index >= names.size()) {
+			return value;
+		}
+		return names[index];
+	}
+
+	static const std::vector<const char *> synchronous_names{"off","normal","full","extra"};
+	static const std::vector<const char *> temp_store_names{"default","file","memory"};
+
+	/// @brief Check if the PRAGMA was applied.
+	static bool mismatch(const string &requested, const string &effective, bool numeric) {
+		if(requested.empty()) {
+			return false;
+		}
+		if(numeric) {
+			return strtoll(requested.c_str(),NULL,10) != strtoll(effective.c_str(),NULL,10);
+		}
+		return strcasecmp(requested.c_str(),effective.c_str()) != 0;
+	}
+
+	/// @brief Add table to the list, if not already there.
+	static void append(std::vector<std::string> &tables, const char *name) {
+		for(const auto &table : tables) {
+			if(!strcasecmp(table.c_str(),name)) {
+				return;
+			}
+		}
+		tables.emplace_back(name);
+	}
+
+	SQL::Pool::Connection::Connection(Pool &p) : pool{p} {
+
+		Options options;
+		{
+			lock_guard<mutex> lock(pool.guard);
+			options = pool.options;
+			revision = pool.revision;
+		}
+
+		Logger::String{"Opening database on '",pool.dbname,"'"}.trace("sqlite");
+
+		int rc = sqlite3_open_v2(pool.dbname, &db, options.flags, NULL);
+		if(rc != SQLITE_OK) {
+			sqlite3_close(db);
+			db = nullptr;
+			throw runtime_error(Logger::String{"Error opening '",pool.dbname,"'"});
+		}
+
+		try {
+
+			if(options.busy_timeout) {
+				sqlite3_busy_timeout(db,(int) options.busy_timeout);
+			}
+
+			// Track the tables changed by this connection for the change watcher.
+			sqlite3_update_hook(db,[](void *connection, int, const char *, const char *table, sqlite3_int64){
+				append(((Connection *) connection)->pending,table);
+			},this);
+
+			sqlite3_commit_hook(db,[](void *ptr) -> int {
+				Connection *connection = (Connection *) ptr;
+				if(!connection->pending.empty()) {
+					for(const auto &table : connection->pending) {
+						append(connection->committed,table.c_str());
+					}
+					connection->pending.clear();
+				}
+				return 0;
+			},this);
+
+			sqlite3_rollback_hook(db,[](void *connection){
+				((Connection *) connection)->pending.clear();
+			},this);
+
+			// Read-only connections can't change the journal mode.
+			string journal_mode = pragma(db,"journal_mode",(options.flags & SQLITE_OPEN_READONLY) ? "" : options.journal_mode);
+			string synchronous = pragma_name(pragma(db,"synchronous",options.synchronous),synchronous_names);
+			string cache_size = pragma(db,"cache_size",options.cache_size);
+			string mmap_size = pragma(db,"mmap_size",options.mmap_size);
+			string temp_store = pragma_name(pragma(db,"temp_store",options.temp_store),temp_store_names);
+
+			lock_guard<mutex> lock(pool.guard);
+
+			// Warn only on the first connection reporting the value.
+			if(journal_mode != pool.effective.journal_mode && mismatch(options.journal_mode,journal_mode,false)) {
+				Logger::String{"Requested journal-mode '",options.journal_mode.c_str(),"' on '",pool.dbname,"', got '",journal_mode.c_str(),"'"}.warning("sqlite");
+			}
+
+			if(mmap_size != pool.effective.mmap_size && mismatch(options.mmap_size,mmap_size,true)) {
+				Logger::String{"Requested mmap-size ",options.mmap_size.c_str()," on '",pool.dbname,"', got ",mmap_size.c_str()}.warning("sqlite");
+			}
+
+			pool.effective.journal_mode = journal_mode;
+			pool.effective.synchronous = synchronous;
+			pool.effective.cache_size = cache_size;
+			pool.effective.mmap_size = mmap_size;
+			pool.effective.temp_store = temp_store;
+
+		} catch(...) {
+
+			sqlite3_close(db);
+			db = nullptr;
+			throw;
+
+		}
+
+	}
+
+	SQL::Pool::Connection::~Connection() {
+
+		for(auto &statement : statements) {
+			sqlite3_finalize(statement.second);
+		}
+		statements.clear();
+		cache.clear();
+
+		if(db) {
+			switch(sqlite3_close(db)) {
+			case SQLITE_OK:
+				Logger::String{"Closing database with NO unfinished operations"}.trace("sqlite");
+				break;
+
+			case SQLITE_BUSY:
+				Logger::String{"Closing database with unfinished operations"}.warning("sqlite");
+				break;
+
+			default:
+				Logger::String{"Unexpected error closing database"}.error("sqlite");
+			}
+			db = nullptr;
+		}
+
+	}
+
+	sqlite3_stmt * SQL::Pool::Connection::prepare(const char *text) {
+
+		auto it = cache.find(text);
+		if(it != cache.end()) {
+			// Cache hit, move statement to the front of the list.
+			pool.statistics.hits++;
+			statements.splice(statements.begin(),statements,it->second);
+			return it->second->second;
+		}
+
+		pool.statistics.misses++;
+
+		debug("Preparing '",text,"'");
+
+		sqlite3_stmt *stmt;
+		int rc = sqlite3_prepare_v2(
+					db,           	// Database handle
+					text,		    // SQL statement, UTF-8 encoded
+					-1,             // Maximum length of zSql in bytes.
+					&stmt,          // OUT: Statement handle
+					NULL            // OUT: Pointer to unused portion of zSql
+				);
+
+		if(rc != SQLITE_OK) {
+			throw runtime_error(sqlite3_errmsg(db));
+		}
+
+		// Evict the least recently used statements.
+		while(!statements.empty() && statements.size() >= pool.limits.statements) {
+			pool.statistics.evictions++;
+			cache.erase(statements.back().first);
+			sqlite3_finalize(statements.back().second);
+			statements.pop_back();
+		}
+
+		statements.emplace_front(text,stmt);
+		cache[text] = statements.begin();
+
+		return stmt;
+
+	}
+
+	void SQL::Pool::for_each(const std::function<void(const Pool &pool)> &method) {
+		lock_guard<mutex> lock(registry.guard);
+		for(auto &pool : registry.pools) {
+			method(*pool.second);
+		}
+	}
+
+	void SQL::Pool::shutdown() {
+		lock_guard<mutex> lock(registry.guard);
+		for(auto &pool : registry.pools) {
+			lock_guard<mutex> lock(pool.second->guard);
+			pool.second->configured = false;
+		}
+	}
+
+	SQL::Pool & SQL::Pool::getInstance(const char *dbname) {
+
+		lock_guard<mutex> lock(registry.guard);
+
+		auto it = registry.pools.find(dbname);
+		if(it != registry.pools.end()) {
+			return *it->second;
+		}
+
+		return *(registry.pools[dbname] = make_unique<Pool>(dbname));
+
+	}
+
+	SQL::Pool::Pool(const char *name) : dbname{name} {
+	}
+
+	SQL::Pool::~Pool() {
+
+		{
+			lock_guard<mutex> lock(guard);
+			poller.enabled = false;
+			poller.wakeup.notify_all();
+		}
+
+		if(poller.thread.joinable()) {
+			poller.thread.join();
+		}
+
+		lock_guard<mutex> lock(guard);
+		for(auto connection : idle) {
+			delete connection;
+		}
+		idle.clear();
+	}
+
+	void SQL::Pool::setup(const XML::Node &node) {
+
+		size_t min = Object::getAttribute(node, "sqlite", "pool-min", (unsigned int) limits.min);
+		size_t max = Object::getAttribute(node, "sqlite", "pool-max", (unsigned int) limits.max);
+		time_t timeout = Object::getAttribute(node, "sqlite", "pool-idle-timeout", (unsigned int) limits.timeout);
+		size_t statements = Object::getAttribute(node, "sqlite", "statement-cache-size", (unsigned int) limits.statements);
+		unsigned int interval = Object::getAttribute(node, "sqlite", "change-poll-interval", poller.interval);
+
+		if(!max) {
+			throw runtime_error("The sqlite pool requires at least one connection");
+		}
+
+		if(!statements) {
+			throw runtime_error("The sqlite statement cache requires at least one entry");
+		}
+
+		if(min > max) {
+			throw runtime_error(Logger::String{"Invalid sqlite pool size, the minimum (",min,") is above the maximum (",max,")"});
+		}
+
+		// Connection options, from <sqlite-options> or from attributes.
+		XML::Node child;
+		for(XML::Node parent = node; parent && !child; parent = parent.parent()) {
+			child = parent.child("sqlite-options");
+		}
+
+		Options options;
+		{
+			lock_guard<mutex> lock(guard);
+			options = this->options;
+		}
+
+		auto option = [&node,&child](const char *name, const std::string &def) -> std::string {
+			if(child && child.attribute(name)) {
+				return String{child.attribute(name).as_string()}.strip().c_str();
+			}
+			return String{Object::getAttribute(node,"sqlite",name,def.c_str())}.strip().c_str();
+		};
+
+		options.journal_mode = option("journal-mode",options.journal_mode);
+		if(!options.journal_mode.empty() && String{options.journal_mode.c_str()}.select("delete","truncate","persist","memory","wal","off",nullptr) < 0) {
+			throw runtime_error(Logger::String{"Invalid journal-mode '",options.journal_mode.c_str(),"', expecting delete, truncate, persist, memory, wal or off"});
+		}
+
+		options.synchronous = option("synchronous",options.synchronous);
+		if(!options.synchronous.empty() && String{options.synchronous.c_str()}.select("off","normal","full","extra",nullptr) < 0) {
+			throw runtime_error(Logger::String{"Invalid synchronous '",options.synchronous.c_str(),"', expecting off, normal, full or extra"});
+		}
+
+		options.temp_store = option("temp-store",options.temp_store);
+		if(!options.temp_store.empty() && String{options.temp_store.c_str()}.select("default","file","memory",nullptr) < 0) {
+			throw runtime_error(Logger::String{"Invalid temp-store '",options.temp_store.c_str(),"', expecting default, file or memory"});
+		}
+
+		// Negative cache size is in KiB, positive in pages.
+		options.cache_size = option("cache-size",options.cache_size);
+		if(!options.cache_size.empty()) {
+			char *end = nullptr;
+			strtoll(options.cache_size.c_str(),&end,10);
+			if(*end) {
+				throw runtime_error(Logger::String{"Invalid cache-size '",options.cache_size.c_str(),"', expecting pages or negative KiB"});
+			}
+		}
+
+		options.mmap_size = option("mmap-size",options.mmap_size);
+		if(!options.mmap_size.empty()) {
+			char *end = nullptr;
+			if(strtoll(options.mmap_size.c_str(),&end,10) < 0 || *end) {
+				throw runtime_error(Logger::String{"Invalid mmap-size '",options.mmap_size.c_str(),"', expecting bytes"});
+			}
+		}
+
+		{
+			std::string value = option("busy-timeout",std::to_string(options.busy_timeout));
+			char *end = nullptr;
+			long long timeout = strtoll(value.c_str(),&end,10);
+			if(value.empty() || *end || timeout < 0 || timeout > INT_MAX) {
+				throw runtime_error(Logger::String{"Invalid busy-timeout '",value.c_str(),"', expecting milliseconds"});
+			}
+			options.busy_timeout = (unsigned int) timeout;
+		}
+
+		if(String{option("read-only",(options.flags & SQLITE_OPEN_READONLY) ? "yes" : "no").c_str()}.as_bool()) {
+			options.flags = SQLITE_OPEN_READONLY | (options.flags & SQLITE_OPEN_NOMUTEX);
+		} else {
+			options.flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | (options.flags & SQLITE_OPEN_NOMUTEX);
+		}
+
+		// Each pooled connection is used by one session at a time.
+		if(String{option("nomutex",(options.flags & SQLITE_OPEN_NOMUTEX) ? "yes" : "no").c_str()}.as_bool()) {
+			options.flags |= SQLITE_OPEN_NOMUTEX;
+		} else {
+			options.flags &= ~SQLITE_OPEN_NOMUTEX;
+		}
+
+		lock_guard<mutex> lock(guard);
+		limits.min = min;
+		limits.max = max;
+		limits.timeout = timeout;
+		limits.statements = statements;
+		poller.interval = interval;
+
+		if(configured) {
+
+			// The first script node configures the database, the others can't change it.
+			if(!(options == this->options)) {
+				Logger::String{"Ignoring sqlite options from <",node.name(),">, '",dbname,"' is already configured"}.warning("sqlite");
+			}
+
+		} else if(!(options == this->options)) {
+
+			this->options = options;
+			revision++;
+
+			// Reopen idle connections with the new options, borrowed ones are closed on release.
+			connections -= idle.size();
+			for(auto connection : idle) {
+				delete connection;
+			}
+			idle.clear();
+
+		}
+		configured = true;
+
+		released.notify_all();
+
+	}
+
+	bool SQL::Pool::Options::operator==(const Options &options) const noexcept {
+		return
+			flags == options.flags
+			&& busy_timeout == options.busy_timeout
+			&& journal_mode == options.journal_mode
+			&& synchronous == options.synchronous
+			&& cache_size == options.cache_size
+			&& mmap_size == options.mmap_size
+			&& temp_store == options.temp_store;
+	}
+
+	Udjat::Value & SQL::Pool::getProperties(Udjat::Value &properties) const {
+
+		lock_guard<mutex> lock(guard);
+
+		properties["database"] = dbname;
+		properties["connections"] = (unsigned int) connections;
+		properties["idle"] = (unsigned int) idle.size();
+		properties["max-connections"] = (unsigned int) limits.max;
+		properties["statement-cache-size"] = (unsigned int) limits.statements;
+		properties["statement-cache-hits"] = (unsigned int) statistics.hits.load();
+		properties["statement-cache-misses"] = (unsigned int) statistics.misses.load();
+		properties["statement-cache-evictions"] = (unsigned int) statistics.evictions.load();
+		properties["generation"] = (unsigned int) changes.load();
+		properties["watching"] = poller.enabled;
+		properties["change-poll-interval"] = poller.interval;
+		properties["read-only"] = (options.flags & SQLITE_OPEN_READONLY) != 0;
+		properties["nomutex"] = (options.flags & SQLITE_OPEN_NOMUTEX) != 0;
+		properties["busy-timeout"] = options.busy_timeout;
+		properties["journal-mode"] = effective.journal_mode.c_str();
+		properties["synchronous"] = effective.synchronous.c_str();
+		properties["cache-size"] = effective.cache_size.c_str();
+		properties["mmap-size"] = effective.mmap_size.c_str();
+		properties["temp-store"] = effective.temp_store.c_str();
+
+		return properties;
+	}
+
+	void SQL::Pool::watch() {
+
+		lock_guard<mutex> lock(guard);
+
+		// In-memory databases can't be changed by other processes.
+		if(poller.enabled || !poller.interval || !strcmp(dbname,":memory:")) {
+			return;
+		}
+
+		if(poller.thread.joinable()) {
+			poller.thread.join();
+		}
+
+		poller.enabled = true;
+		poller.thread = std::thread([this](){
+			poll();
+		});
+
+	}
+
+	void SQL::Pool::poll() {
+
+		// Own connection, the data version is relative to it.
+		sqlite3 *db = nullptr;
+		if(sqlite3_open_v2(dbname, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+			Logger::String{"Unable to watch '",dbname,"': ",sqlite3_errmsg(db)}.error("sqlite");
+			sqlite3_close(db);
+			lock_guard<mutex> lock(guard);
+			poller.enabled = false;
+			return;
+		}
+
+		Logger::String{"Watching '",dbname,"' for changes every ",poller.interval,"ms"}.trace("sqlite");
+
+		sqlite3_stmt *stmt = nullptr;
+		if(sqlite3_prepare_v2(db,"PRAGMA data_version",-1,&stmt,NULL) != SQLITE_OK) {
+			Logger::String{"Unable to watch '",dbname,"': ",sqlite3_errmsg(db)}.error("sqlite");
+			sqlite3_close(db);
+			lock_guard<mutex> lock(guard);
+			poller.enabled = false;
+			return;
+		}
+
+		long long version = -1;
+
+		unique_lock<mutex> lock(guard);
+		while(poller.enabled) {
+
+			poller.wakeup.wait_for(lock,std::chrono::milliseconds(poller.interval),[this]{
+				return !poller.enabled;
+			});
+
+			if(!poller.enabled) {
+				break;
+			}
+
+			// Expire idle connections on databases without traffic.
+			cleanup(time(nullptr));
+
+			lock.unlock();
+
+			long long value = version;
+			if(sqlite3_step(stmt) == SQLITE_ROW) {
+				value = sqlite3_column_int64(stmt,0);
+			}
+			sqlite3_reset(stmt);
+
+			// Commits from this process change the version too and can't be told apart from the
+			// others; notify only the subscriptions accepting external changes, the table filter
+			// on the other ones is kept for the writes from this process.
+			if(version >= 0 && value != version) {
+				debug("Database '",dbname,"' was changed");
+				changed();
+				SQL::Watcher::external(dbname);
+			}
+
+			version = value;
+
+			lock.lock();
+
+		}
+		lock.unlock();
+
+		sqlite3_finalize(stmt);
+		sqlite3_close(db);
+
+	}
+
+	void SQL::Pool::cleanup(time_t now) {
+
+		// Idle list is ordered by use, the oldest ones are at the end.
+		while(connections > limits.min && !idle.empty() && (idle.back()->used + limits.timeout) <= now) {
+			delete idle.back();
+			idle.pop_back();
+			connections--;
+		}
+
+	}
+
+	SQL::Pool::Connection * SQL::Pool::borrow() {
+
+		{
+			unique_lock<mutex> lock(guard);
+
+			// Expire idle connections even without releases.
+			cleanup(time(nullptr));
+
+			released.wait(lock,[this]{
+				return !idle.empty() || connections < limits.max;
+			});
+
+			if(!idle.empty()) {
+				Connection *connection = idle.front();
+				idle.pop_front();
+				return connection;
+			}
+
+			// Reserve a slot for the new connection.
+			connections++;
+		}
+
+		// Open the new connection outside of the lock.
+		try {
+
+			return new Connection(*this);
+
+		} catch(...) {
+
+			lock_guard<mutex> lock(guard);
+			connections--;
+			released.notify_one();
+			throw;
+
+		}
+
+	}
+
+	void SQL::Pool::release(Connection *connection) {
+
+		// Notify the committed changes, the transaction is finished and the tables are visible.
+		if(!connection->committed.empty()) {
+			SQL::Watcher::changed(dbname,connection->committed);
+			connection->committed.clear();
+		}
+
+		lock_guard<mutex> lock(guard);
+
+		time_t now = time(nullptr);
+		connection->used = now;
+
+		if(connections > limits.max || connection->revision != revision) {
+			// Pool was resized or the connection options are outdated, drop the connection.
+			delete connection;
+			connections--;
+		} else {
+			idle.push_front(connection);
+		}
+
+		cleanup(now);
+		released.notify_one();
+
+	}
+
+ }
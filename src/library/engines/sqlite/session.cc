@@ -26,56 +26,183 @@
  #include <udjat/tools/logger.h>
  #include <udjat/tools/sql/script.h>
  #include <mutex>
+ #include <shared_mutex>
+ #include <strings.h>
  #include <sqlite3.h>
  #include <private/sqlite.h>
- #include <mutex>
 
  using namespace std;
 
  namespace Udjat {
 
-	std::mutex SQL::Session::guard;
+	SQL::Session::Session(const char *dbname) : pool{Pool::getInstance(dbname)}, connection{pool.borrow()}, db{connection->db}, probe{this} {
+	}
 
-	SQL::Session::Session(const char *dbname) {
+	SQL::Session::~Session() {
+		pool.release(connection);
+	}
 
-		lock_guard<std::mutex> lock(guard);
+	SQL::Session::Lock::Lock(Session &session, sqlite3_stmt *s) : pool{session.pool}, access{session.pool.access}, stmt{s}, readonly{sqlite3_stmt_readonly(s) != 0}, owner{!session.locked} {
+		if(!owner) {
+			return;
+		} else if(readonly) {
+			access.lock_shared();
+		} else {
+			access.lock();
+		}
+	}
 
-		Logger::String{"Opening database on '",dbname,"'"}.trace("sqlite");
+	SQL::Session::Lock::~Lock() {
+
+		// Reset the statement to end the implicit transaction before unlocking
+		// and return it clean to the connection cache.
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+
+		if(!owner) {
+			// The transaction will unlock on commit or rollback.
+			return;
+		} else if(readonly) {
+			access.unlock_shared();
+		} else {
+			// Invalidate cached responses before other sessions can read.
+			pool.changed();
+			access.unlock();
+		}
+	}
 
-		// Open database.
-		int rc = sqlite3_open(dbname, &db);
-		if(rc != SQLITE_OK) {
-			db = nullptr;
-			throw runtime_error(Logger::String{"Error opening '",dbname,"'"});
+	void SQL::Session::check(int rc) {
+		if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+			throw runtime_error(sqlite3_errmsg(db));
 		}
 	}
 
-	SQL::Session::~Session() {
+	void SQL::Session::exec(const char *sql) {
+		debug(sql);
+		check(sqlite3_exec(db,sql,NULL,NULL,NULL));
+	}
 
-		lock_guard<std::mutex> lock(guard);
+	SQL::Session::Transaction::Transaction(Session &s, SQL::Script::Transaction mode, bool r) : session{s}, readonly{r} {
 
-		if(db) {
-			switch(sqlite3_close(db)) {
-			case SQLITE_OK:
-				Logger::String{"Closing database with NO unfinished operations"}.trace("sqlite");
-				break;
+		if(mode == SQL::Script::NoTransaction || session.locked) {
+			// Autocommit or already on a transaction.
+			return;
+		}
 
-			case SQLITE_BUSY:
-				Logger::String{"Closing database with unfinished operations"}.warning("sqlite");
-				break;
+		// Get the access lock first, concurrent writers wait here instead of failing with 'busy'.
+		// 'BEGIN IMMEDIATE' and 'BEGIN EXCLUSIVE' get the database write lock even on readonly scripts.
+		shared = readonly && mode != SQL::Script::Immediate && mode != SQL::Script::Exclusive;
+		if(shared) {
+			session.pool.access.lock_shared();
+		} else {
+			session.pool.access.lock();
+		}
+		session.locked = owner = true;
+
+		static const char *statements[] = {
+			"BEGIN",
+			"BEGIN DEFERRED",
+			"BEGIN IMMEDIATE",
+			"BEGIN EXCLUSIVE"
+		};
+
+		try {
+			session.exec(statements[mode]);
+		} catch(...) {
+			unlock();
+			throw;
+		}
 
-			default:
-				Logger::String{"Unexpected error closing database"}.error("sqlite");
+		active = true;
+
+	}
+
+	SQL::Session::Transaction::Transaction(Session &s, const SQL::Script &script) : Transaction{s,script.transaction(),script.readonly()} {
+	}
+
+	void SQL::Session::Transaction::unlock() noexcept {
+
+		if(!owner) {
+			return;
+		}
+
+		owner = session.locked = false;
+
+		if(shared) {
+			session.pool.access.unlock_shared();
+		} else {
+			session.pool.access.unlock();
+		}
+
+	}
+
+	SQL::Session::Transaction::~Transaction() {
+
+		if(active) {
+			if(sqlite3_exec(session.db,"ROLLBACK",NULL,NULL,NULL) != SQLITE_OK) {
+				Logger::String{"Rollback has failed: ",sqlite3_errmsg(session.db)}.error("sqlite");
 			}
-			db = nullptr;
 		}
 
+		unlock();
+
 	}
 
-	void SQL::Session::check(int rc) {
-		if (rc != SQLITE_OK && rc != SQLITE_DONE) {
-			throw runtime_error(sqlite3_errmsg(db));
+	void SQL::Session::Transaction::commit() {
+
+		if(active) {
+
+			session.exec("COMMIT");
+			active = false;
+
+			if(!readonly) {
+				// Invalidate cached responses before other sessions can read.
+				session.pool.changed();
+			}
+
 		}
+
+		unlock();
+
+	}
+
+	std::vector<SQL::Script::Result> SQL::Session::batch(const SQL::Script &script, size_t count, const std::function<void(size_t row, SQL::Script::Result &result)> &method) {
+		return batch(script.transaction(),count,method);
+	}
+
+	std::vector<SQL::Script::Result> SQL::Session::batch(SQL::Script::Transaction mode, size_t count, const std::function<void(size_t row, SQL::Script::Result &result)> &method) {
+
+		std::vector<SQL::Script::Result> results(count);
+
+		// The batch is always one transaction, get the write lock up front.
+		Transaction transaction{*this,(mode == SQL::Script::Exclusive ? SQL::Script::Exclusive : SQL::Script::Immediate)};
+
+		for(size_t row = 0; row < count; row++) {
+
+			// The prepared statements are kept on the connection cache,
+			// every row just rebinds the parameters.
+			exec("SAVEPOINT udjat_batch_row");
+			try {
+
+				method(row,results[row]);
+				exec("RELEASE udjat_batch_row");
+
+			} catch(const std::exception &e) {
+
+				results[row].error = e.what();
+				Logger::String{"Batch row ",row," has failed: ",e.what()}.warning("sqlite");
+
+				exec("ROLLBACK TO udjat_batch_row");
+				exec("RELEASE udjat_batch_row");
+
+			}
+
+		}
+
+		transaction.commit();
+
+		return results;
+
 	}
 
 	sqlite3_stmt * SQL::Session::prepare(const char *text) {
@@ -95,85 +222,237 @@
 		return stmt;
 	}
 
+	std::string SQL::Session::explain(const char *text) {
+
+		string sql{"EXPLAIN QUERY PLAN "};
+		sql += text;
+
+		// A running transaction already holds the access lock.
+		shared_lock<shared_mutex> lock(pool.access,defer_lock);
+		if(!locked) {
+			lock.lock();
+		}
+
+		sqlite3_stmt *stmt = prepare(sql.c_str());
+
+		// The plan step description is on the 4th column.
+		string plan;
+		while(sqlite3_step(stmt) == SQLITE_ROW) {
+			if(!plan.empty()) {
+				plan += "; ";
+			}
+			const char *detail = (const char *) sqlite3_column_text(stmt,3);
+			if(detail) {
+				plan += detail;
+			}
+		}
+
+		sqlite3_finalize(stmt);
+
+		return plan;
+
+	}
+
+	sqlite3_stmt * SQL::Session::statement(const char *text) {
+		return connection->prepare(text);
+	}
+
 	sqlite3_stmt * SQL::Session::prepare(const SQL::Statement &script) {
-		return prepare(script.text);
+		return connection->prepare(script.text);
+	}
+
+	void SQL::Session::bind(sqlite3_stmt *stmt, int column, const Parameter &parameter) {
+
+		switch(parameter.type) {
+		case Parameter::Null:
+			check(sqlite3_bind_null(stmt,column));
+			break;
+
+		case Parameter::Integer:
+			check(sqlite3_bind_int64(stmt,column,parameter.integer));
+			break;
+
+		case Parameter::Real:
+			check(sqlite3_bind_double(stmt,column,parameter.real));
+			break;
+
+		case Parameter::Text:
+			// The parameter is kept until the statement reset, no need to copy.
+			check(
+				sqlite3_bind_text(
+					stmt,
+					column,
+					parameter.text.c_str(),
+					parameter.text.size(),
+					SQLITE_STATIC
+				)
+			);
+			break;
+
+		}
+
 	}
 
 	void SQL::Session::bind(const SQL::Statement &script, sqlite3_stmt *stmt, const Abstract::Object &request, Udjat::Value &response) {
 
+		parameters.resize(script.parameter_names.size());
+
 		int column = 1;
 		for(const char *name : script.parameter_names) {
 
-			string value;
+			Parameter &parameter = parameters[column-1];
+
+			if(!parameter.set(request,response,name)) {
+				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+			}
+
+			debug("value(",column,",'",name,"') type ",(int) parameter.type);
+			bind(stmt,column,parameter);
+			column++;
 
-			if(request.getProperty(name,value)) {
+		}
 
-				debug("value(",column,",'",name,"')='",value,"' (from request)");
-				check(
-					sqlite3_bind_text(
-						stmt,
-						column,
-						value.c_str(),
-						value.size()+1,
-						SQLITE_TRANSIENT
-					)
-				);
+	}
 
-			} else if(response.getProperty(name,value)) {
+	void SQL::Session::bind(const SQL::Statement &script, sqlite3_stmt *stmt, Udjat::Value &response) {
 
-				debug("value(",column,",'",name,"')='",value,"' (from response)");
-				check(
-					sqlite3_bind_text(
-						stmt,
-						column,
-						value.c_str(),
-						value.size()+1,
-						SQLITE_TRANSIENT
-					)
-				);
+		parameters.resize(script.parameter_names.size());
 
-			} else {
+		int column = 1;
+		for(const char *name : script.parameter_names) {
 
-				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+			Parameter &parameter = parameters[column-1];
 
+			if(!parameter.set(response,name)) {
+				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
 			}
+
+			debug("value(",column,",'",name,"') type ",(int) parameter.type);
+			bind(stmt,column,parameter);
 			column++;
 
 		}
 
 	}
 
-	void SQL::Session::bind(const SQL::Statement &script, sqlite3_stmt *stmt, Udjat::Value &response) {
+	void SQL::Session::bind(const SQL::Statement &script, sqlite3_stmt *stmt, const Request &request) {
+
+		parameters.resize(script.parameter_names.size());
 
 		int column = 1;
 		for(const char *name : script.parameter_names) {
 
-			string value;
+			Parameter &parameter = parameters[column-1];
 
-			if(response.getProperty(name,value)) {
+			if(!parameter.set(request,name)) {
+				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+			}
 
-				debug("value(",column,",'",name,"')='",value,"' (from request)");
-				check(
-					sqlite3_bind_text(
-						stmt,
-						column,
-						value.c_str(),
-						value.size()+1,
-						SQLITE_TRANSIENT
-					)
-				);
+			debug("value(",column,",'",name,"')='",parameter.text,"' (from request)");
+			bind(stmt,column,parameter);
+			column++;
 
-			} else {
+		}
 
-				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+	}
+
+	void SQL::Session::bind(const SQL::Statement &script, sqlite3_stmt *stmt, const Abstract::Object &request) {
 
+		parameters.resize(script.parameter_names.size());
+
+		int column = 1;
+		for(const char *name : script.parameter_names) {
+
+			Parameter &parameter = parameters[column-1];
+
+			if(!parameter.set(request,name)) {
+				throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
 			}
+
+			debug("value(",column,",'",name,"') type ",(int) parameter.type);
+			bind(stmt,column,parameter);
 			column++;
 
 		}
 
 	}
 
+	int SQL::Session::column(sqlite3_stmt *stmt, const char *name) {
+
+		int colnum = sqlite3_column_count(stmt);
+		for(int col = 0; col < colnum; col++) {
+			if(!strcasecmp(sqlite3_column_name(stmt,col),name)) {
+				return col;
+			}
+		}
+
+		return -1;
+
+	}
+
+	bool SQL::Session::get(const SQL::Script &script, const Abstract::Object &request, const char *name, const std::function<void(sqlite3_stmt *stmt, int column)> &fetch) {
+
+		if(script.size() != 1) {
+			throw runtime_error("Single value query requires a single statement script");
+		}
+
+		const SQL::Statement &statement = *script.begin();
+		bool found = false;
+
+		Transaction transaction{*this,script};
+
+		probe.start(statement);
+		try {
+
+			// From the connection cache, prepared only once for each connection.
+			sqlite3_stmt *stmt = prepare(statement);
+			probe.phase(Statistics::Prepare);
+
+			Lock lock{*this,stmt};
+			probe.resume();
+
+			bind(statement, stmt, request);
+			probe.phase(Statistics::Bind);
+
+			switch(sqlite3_step(stmt)) {
+			case SQLITE_DONE:	// Executed, no row
+				probe.phase(Statistics::Step);
+				break;
+
+			case SQLITE_ROW:	// Got a row.
+				{
+					probe.phase(Statistics::Step);
+					int col = column(stmt,name);
+					if(col < 0) {
+						Logger::String{"Query has no column '",name,"'"}.warning("sqlite");
+					} else if(sqlite3_column_type(stmt,col) != SQLITE_NULL) {
+						fetch(stmt,col);
+						found = true;
+					}
+					probe.phase(Statistics::Fetch);
+					probe.row();
+				}
+				break;
+
+			default:
+				throw runtime_error(sqlite3_errmsg(db));
+
+			}
+
+		} catch(...) {
+
+			probe.finish(true);
+			throw;
+
+		}
+		probe.finish();
+
+		transaction.commit();
+
+		return found;
+
+	}
+
 	void SQL::Session::get(sqlite3_stmt *stmt, Udjat::Value &response) {
 
 		int colnum = sqlite3_data_count(stmt);
@@ -211,7 +490,8 @@
 
 	}
 
-	void SQL::Session::get(sqlite3_stmt *stmt, Udjat::Response::Table &response) {
+	template <typename T>
+	void SQL::Session::get(sqlite3_stmt *stmt, T &response) {
 
 		int colnum = sqlite3_data_count(stmt);
 
@@ -250,6 +530,8 @@
 	int SQL::Session::step(sqlite3_stmt *stmt, Udjat::Value &response) {
 
 		int state = sqlite3_step(stmt);
+		probe.phase(Statistics::Step);
+
 		switch(state) {
 		case SQLITE_DONE:	// Executed, no row
 			debug("sqlite-done");
@@ -257,6 +539,8 @@
 
 		case SQLITE_ROW:	// Got a row.
 			get(stmt,response);
+			probe.phase(Statistics::Fetch);
+			probe.row();
 			break;
 
 		default:
@@ -267,116 +551,182 @@
 		return state;
 	}
 
-	void SQL::Session::exec(const std::vector<SQL::Statement> &scripts, const Abstract::Object &request, Udjat::Value &response) {
+	int SQL::Session::step(sqlite3_stmt *stmt, Udjat::Value &response, const SQL::Script &script) {
+
+		const char *name = script.result_set();
+		if(!(name && *name && sqlite3_column_count(stmt))) {
+			// Single row mode.
+			return step(stmt,response);
+		}
+
+		// Store all rows on the result set.
+		Udjat::Value &rows = response[name];
+		if(rows.isNull()) {
+			rows.reset(Udjat::Value::Array);
+		}
+
+		size_t max = script.max_rows();
+		size_t count = 0;
+		int state = SQLITE_DONE;
+
+		while(!max || count < max) {
+
+			state = sqlite3_step(stmt);
+			probe.phase(Statistics::Step);
+
+			if(state == SQLITE_DONE) {
+				break;
+			} else if(state != SQLITE_ROW) {
+				throw runtime_error(sqlite3_errmsg(db));
+			}
+
+			get(stmt,rows.append(Udjat::Value::Object));
+			probe.phase(Statistics::Fetch);
+			probe.row();
+			count++;
+
+		}
+
+		debug(count," row(s) stored on '",name,"'");
+		return state;
+
+	}
+
+	void SQL::Session::exec(const SQL::Script &script, const Abstract::Object &request, Udjat::Value &response) {
 
 		debug(__FUNCTION__);
-		lock_guard<std::mutex> lock(guard);
 
-		for(auto &script : scripts) {
-			if(script.text && *script.text) {
-				sqlite3_stmt *stmt = prepare(script);
+		Transaction transaction{*this,script};
+
+		for(auto &statement : script) {
+			if(statement.text && *statement.text) {
+				probe.start(statement);
 				try {
 
-					bind(script, stmt, request, response);
-					step(stmt, response);
+					sqlite3_stmt *stmt = prepare(statement);
+					probe.phase(Statistics::Prepare);
+
+					Lock lock{*this,stmt};
+					probe.resume();
+
+					bind(statement, stmt, request, response);
+					probe.phase(Statistics::Bind);
+
+					step(stmt, response, script);
 
 				} catch(...) {
-					sqlite3_finalize(stmt);
+
+					probe.finish(true);
 					throw;
+
 				}
-				sqlite3_finalize(stmt);
+				probe.finish();
 			}
 		}
 
+		transaction.commit();
+
 	}
 
-	void SQL::Session::exec(const std::vector<SQL::Statement> &scripts, Udjat::Value &response) {
+	void SQL::Session::exec(const SQL::Script &script, Udjat::Value &response) {
 
 		debug(__FUNCTION__);
-		lock_guard<std::mutex> lock(guard);
 
-		for(auto &script : scripts) {
-			if(script.text && *script.text) {
-				sqlite3_stmt *stmt = prepare(script);
+		Transaction transaction{*this,script};
+
+		for(auto &statement : script) {
+			if(statement.text && *statement.text) {
+				probe.start(statement);
 				try {
 
-					bind(script, stmt, response);
-					step(stmt, response);
+					sqlite3_stmt *stmt = prepare(statement);
+					probe.phase(Statistics::Prepare);
+
+					Lock lock{*this,stmt};
+					probe.resume();
+
+					bind(statement, stmt, response);
+					probe.phase(Statistics::Bind);
+
+					step(stmt, response, script);
 
 				} catch(...) {
-					sqlite3_finalize(stmt);
+
+					probe.finish(true);
 					throw;
+
 				}
-				sqlite3_finalize(stmt);
+				probe.finish();
 			}
 		}
 
+		transaction.commit();
 
 	}
 
-	void SQL::Session::exec(const std::vector<SQL::Statement> &scripts, const Request &request, Udjat::Value &response) {
+	void SQL::Session::exec(const SQL::Script &script, const Request &request, Udjat::Value &response) {
 
 		debug(__FUNCTION__);
-		lock_guard<std::mutex> lock(guard);
 
-		for(auto &script : scripts) {
-			if(script.text && *script.text) {
-				sqlite3_stmt *stmt = prepare(script);
+		Transaction transaction{*this,script};
+
+		for(auto &statement : script) {
+			if(statement.text && *statement.text) {
+				probe.start(statement);
 				try {
 
-					bind(script, stmt, request, response);
-					step(stmt, response);
+					sqlite3_stmt *stmt = prepare(statement);
+					probe.phase(Statistics::Prepare);
+
+					Lock lock{*this,stmt};
+					probe.resume();
+
+					bind(statement, stmt, request, response);
+					probe.phase(Statistics::Bind);
+
+					step(stmt, response, script);
 
 				} catch(...) {
-					sqlite3_finalize(stmt);
+
+					probe.finish(true);
 					throw;
+
 				}
-				sqlite3_finalize(stmt);
+				probe.finish();
 			}
 		}
 
+		transaction.commit();
+
 	}
 
-	void SQL::Session::exec(const std::vector<SQL::Statement> &scripts, const Request &request, Udjat::Response::Table &response) {
+	template <typename T>
+	void SQL::Session::table(const SQL::Script &script, const Request &request, T &response) {
 
 		debug(__FUNCTION__);
-		lock_guard<std::mutex> lock(guard);
 
-		for(auto &script : scripts) {
-			if(script.text && *script.text) {
-				sqlite3_stmt *stmt = prepare(script);
-				try {
+		size_t max = script.max_rows();
 
-					{
-						int column = 1;
-						for(const char *name : script.parameter_names) {
+		Transaction transaction{*this,script};
 
-							string value;
+		for(auto &statement : script) {
+			if(statement.text && *statement.text) {
 
-							if(request.getProperty(name,value)) {
-
-								debug("value(",name,")='",value,"' (from request)");
-								check(
-									sqlite3_bind_text(
-										stmt,
-										column,
-										value.c_str(),
-										value.size()+1,
-										SQLITE_TRANSIENT
-									)
-								);
-
-							} else {
+				probe.start(statement);
+				try {
 
-								throw runtime_error(Logger::String{"Required property '",name,"' is missing"});
+					sqlite3_stmt *stmt = prepare(statement);
+					probe.phase(Statistics::Prepare);
 
-							}
-							column++;
+					Lock lock{*this,stmt};
+					probe.resume();
 
-						}
-					}
+					bind(statement, stmt, request);
+					probe.phase(Statistics::Bind);
 
 					int state = sqlite3_step(stmt);
+					probe.phase(Statistics::Step);
+
 					switch(state) {
 					case SQLITE_DONE:	// Executed, no row
 						break;
@@ -395,9 +745,24 @@
 
 							// Get first row.
 							get(stmt,response);
+							probe.phase(Statistics::Fetch);
+							probe.row();
+
+							size_t rows = 1;
+							while(!max || rows < max) {
+
+								state = sqlite3_step(stmt);
+								probe.phase(Statistics::Step);
+
+								if(state != SQLITE_ROW) {
+									break;
+								}
 
-							while(sqlite3_step(stmt) == SQLITE_ROW) {
 								get(stmt,response);
+								probe.phase(Statistics::Fetch);
+								probe.row();
+								rows++;
+
 							}
 
 						}
@@ -409,13 +774,26 @@
 					}
 
 				} catch(...) {
-					sqlite3_finalize(stmt);
+
+					probe.finish(true);
 					throw;
+
 				}
-				sqlite3_finalize(stmt);
+				probe.finish();
+
 			}
 		}
 
+		transaction.commit();
+
+	}
+
+	void SQL::Session::exec(const SQL::Script &script, const Request &request, Udjat::Response::Table &response) {
+		table(script,request,response);
+	}
+
+	void SQL::Session::exec(const SQL::Script &script, const Request &request, SQL::Rows &response) {
+		table(script,request,response);
 	}
 
  }
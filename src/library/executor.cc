@@ -0,0 +1,318 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the per database executor and the asynchronous scripts.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/object.h>
+ #include <udjat/tools/string.h>
+ #include <udjat/tools/sql/script.h>
+ #include <private/executor.h>
+ #include <memory>
+ #include <unordered_map>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Active executors, indexed by the interned database name.
+	static struct {
+		mutex guard;
+		unordered_map<const char *, unique_ptr<SQL::Executor>> executors;
+	} registry;
+
+	/// @brief True on executor threads.
+	static thread_local bool running_task = false;
+
+	SQL::Executor & SQL::Executor::getInstance(const char *dbname) {
+
+		lock_guard<mutex> lock(registry.guard);
+
+		auto it = registry.executors.find(dbname);
+		if(it != registry.executors.end()) {
+			return *it->second;
+		}
+
+		return *(registry.executors[dbname] = make_unique<Executor>(dbname));
+
+	}
+
+	void SQL::Executor::for_each(const std::function<void(const Executor &executor)> &method) {
+		lock_guard<mutex> lock(registry.guard);
+		for(auto &executor : registry.executors) {
+			method(*executor.second);
+		}
+	}
+
+	void SQL::Executor::shutdown() {
+
+		// Stop outside of the registry lock, running tasks can queue new ones.
+		std::vector<Executor *> executors;
+		{
+			lock_guard<mutex> lock(registry.guard);
+			for(auto &executor : registry.executors) {
+				executors.push_back(executor.second.get());
+			}
+		}
+
+		for(auto executor : executors) {
+			executor->stop();
+		}
+
+	}
+
+	SQL::Executor::Executor(const char *name) : dbname{name} {
+	}
+
+	SQL::Executor::~Executor() {
+		stop();
+	}
+
+	void SQL::Executor::stop() {
+
+		{
+			lock_guard<mutex> lock(guard);
+			enabled = false;
+			queued.notify_all();
+			dequeued.notify_all();
+		}
+
+		for(auto &thread : threads) {
+			if(thread.joinable()) {
+				thread.join();
+			}
+		}
+		threads.clear();
+
+	}
+
+	void SQL::Executor::setup(const XML::Node &node) {
+
+		size_t threads = Object::getAttribute(node, "sql", "executor-threads", (unsigned int) limits.threads);
+		size_t queue = Object::getAttribute(node, "sql", "executor-queue-size", (unsigned int) limits.queue);
+
+		if(!threads) {
+			throw runtime_error("The SQL executor requires at least one thread");
+		}
+
+		if(!queue) {
+			throw runtime_error("The SQL executor requires at least one queue slot");
+		}
+
+		Overflow overflow = limits.overflow;
+		if(node.attribute("executor-overflow")) {
+			switch(String{node,"executor-overflow","wait"}.select("wait","reject","caller",nullptr)) {
+			case 0:
+				overflow = Wait;
+				break;
+
+			case 1:
+				overflow = Reject;
+				break;
+
+			case 2:
+				overflow = Caller;
+				break;
+
+			default:
+				throw runtime_error(Logger::String{"Invalid executor-overflow '",node.attribute("executor-overflow").as_string(),"', expecting wait, reject or caller"});
+			}
+		}
+
+		lock_guard<mutex> lock(guard);
+		limits.threads = threads;
+		limits.queue = queue;
+		limits.overflow = overflow;
+
+		// Module reload, the executor was stopped by the previous shutdown.
+		enabled = true;
+
+		dequeued.notify_all();
+
+	}
+
+	Udjat::Value & SQL::Executor::getProperties(Udjat::Value &properties) const {
+
+		static const char *overflows[] = { "wait", "reject", "caller" };
+
+		lock_guard<mutex> lock(guard);
+
+		properties["database"] = dbname;
+		properties["threads"] = (unsigned int) threads.size();
+		properties["busy"] = (unsigned int) busy;
+		properties["queued"] = (unsigned int) tasks.size();
+		properties["max-threads"] = (unsigned int) limits.threads;
+		properties["queue-size"] = (unsigned int) limits.queue;
+		properties["overflow"] = overflows[limits.overflow];
+		properties["completed"] = (unsigned int) statistics.completed.load();
+		properties["rejected"] = (unsigned int) statistics.rejected.load();
+		properties["inline"] = (unsigned int) statistics.inline_runs.load();
+
+		return properties;
+	}
+
+	void SQL::Executor::push(std::function<void()> task) {
+
+		{
+			unique_lock<mutex> lock(guard);
+
+			if(!enabled) {
+				throw runtime_error(Logger::String{"The executor for '",dbname,"' was stopped"});
+			}
+
+			if(tasks.size() >= limits.queue) {
+
+				// A task waiting for room on an executor queue can block the thread that would make it.
+				Overflow overflow = (limits.overflow == Wait && running_task) ? Caller : limits.overflow;
+
+				switch(overflow) {
+				case Wait:
+					dequeued.wait(lock,[this]{
+						return !enabled || tasks.size() < limits.queue;
+					});
+					if(!enabled) {
+						throw runtime_error(Logger::String{"The executor for '",dbname,"' was stopped"});
+					}
+					break;
+
+				case Reject:
+					statistics.rejected++;
+					throw runtime_error(Logger::String{"The executor queue for '",dbname,"' is full"});
+
+				case Caller:
+					statistics.inline_runs++;
+					lock.unlock();
+					task();
+					return;
+
+				}
+
+			}
+
+			tasks.push_back(std::move(task));
+
+			// Start a new thread if all the current ones are busy.
+			if(threads.size() < limits.threads && (busy + tasks.size()) > threads.size()) {
+				threads.emplace_back([this]{
+					worker();
+				});
+			}
+
+			queued.notify_one();
+		}
+
+	}
+
+	void SQL::Executor::worker() {
+
+		running_task = true;
+
+		unique_lock<mutex> lock(guard);
+
+		while(true) {
+
+			queued.wait(lock,[this]{
+				return !enabled || !tasks.empty();
+			});
+
+			if(tasks.empty()) {
+				// Stopped and there's nothing left to run.
+				break;
+			}
+
+			auto task = std::move(tasks.front());
+			tasks.pop_front();
+			busy++;
+			dequeued.notify_one();
+
+			lock.unlock();
+
+			try {
+
+				task();
+
+			} catch(const std::exception &e) {
+
+				Logger::String{"Error running task: ",e.what()}.error(dbname);
+
+			} catch(...) {
+
+				Logger::String{"Unexpected error running task"}.error(dbname);
+
+			}
+
+			statistics.completed++;
+
+			lock.lock();
+			busy--;
+
+		}
+
+	}
+
+	void SQL::Script::async(std::shared_ptr<Udjat::Value> response, const std::function<void(std::exception_ptr error)> &completion) const {
+
+		// Run a copy, the script doesn't need to outlive the task.
+		auto script = make_shared<Script>(*this);
+
+		Executor::getInstance(dburl).push([script,response,completion](){
+
+			std::exception_ptr error;
+
+			try {
+
+				script->exec(response);
+
+			} catch(...) {
+
+				error = std::current_exception();
+
+			}
+
+			if(completion) {
+				completion(error);
+			}
+
+		});
+
+	}
+
+	std::future<void> SQL::Script::async(std::shared_ptr<Udjat::Value> response) const {
+
+		auto promise = make_shared<std::promise<void>>();
+		auto future = promise->get_future();
+
+		async(response,[promise](std::exception_ptr error){
+			if(error) {
+				promise->set_exception(error);
+			} else {
+				promise->set_value();
+			}
+		});
+
+		return future;
+
+	}
+
+ }
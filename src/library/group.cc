@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements SQL agent groups.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/xml.h>
+ #include <udjat/tools/quark.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/agent/sql.h>
+ #include <cstring>
+ #include <strings.h>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Find named value.
+	/// @return nullptr if not found.
+	static const Udjat::Value * find(const Udjat::Value &object, const char *name) {
+
+		const Udjat::Value *found = nullptr;
+
+		object.for_each([name,&found](const char *key, const Udjat::Value &value){
+			if(!strcasecmp(key,name)) {
+				found = &value;
+				return true;
+			}
+			return false;
+		});
+
+		return found;
+
+	}
+
+	SQL::Group::Group(const XML::Node &node, const char *c) : column{c}, fed{!node.child("refresh")} {
+
+		const char *name = node.attribute("key-from").as_string();
+		if(name && *name) {
+			key.column = Quark{name}.c_str();
+			key.value = Quark{node.attribute("key").as_string()}.c_str();
+		}
+
+		if(node.attribute("value-default")) {
+			missing = Quark{node.attribute("value-default").as_string()}.c_str();
+		}
+
+	}
+
+	SQL::Group::~Group() {
+	}
+
+	bool SQL::Group::attach(std::shared_ptr<Group> child) {
+
+		if(!(child && child->fed)) {
+			return false;
+		}
+
+		children.push_back(child);
+		return true;
+
+	}
+
+	void SQL::Group::distribute(const Udjat::Value &results, const char *result_set) const {
+
+		const Udjat::Value *rows = nullptr;
+		if(result_set && *result_set) {
+			rows = find(results,result_set);
+		}
+
+		for(const auto &child : children) {
+
+			const Udjat::Value *value = nullptr;
+
+			if(!rows) {
+
+				// Single row results, the columns are on the response.
+				value = find(results,child->column);
+
+			} else {
+
+				// Multi-row results, get the row with the child key or the first one.
+				rows->for_each([&child,&value](const char *, const Udjat::Value &row){
+
+					if(child->key.column) {
+						const Udjat::Value *key = find(row,child->key.column);
+						if(!(key && !strcmp(key->as_string().c_str(),child->key.value))) {
+							return false;
+						}
+					}
+
+					value = find(row,child->column);
+					return true;
+
+				});
+
+			}
+
+			try {
+
+				if(value && !value->isNull()) {
+					child->feed(value->as_string().c_str());
+				} else if(child->missing) {
+					child->feed(child->missing);
+				}
+
+			} catch(const std::exception &e) {
+
+				Logger::String{"Unable to update agent from column '",child->column,"': ",e.what()}.error("sql");
+
+			}
+
+		}
+
+	}
+
+ }
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements SQL statement parameter.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/abstract/object.h>
+ #include <udjat/agent/abstract.h>
+ #include <private/parameter.h>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	bool SQL::Parameter::set(const Udjat::Value &value, const char *name) {
+
+		if(!value.contains(name)) {
+			return false;
+		}
+
+		const Udjat::Value &item = value[name];
+
+		switch((Udjat::Value::Type) item) {
+		case Udjat::Value::Undefined:
+			type = Null;
+			break;
+
+		case Udjat::Value::Signed:
+		case Udjat::Value::Boolean:
+			type = Integer;
+			item.get(integer);
+			break;
+
+		case Udjat::Value::Unsigned:
+			{
+				unsigned long long unsig = 0;
+				item.get(unsig);
+				type = Integer;
+				integer = (long long) unsig;
+			}
+			break;
+
+		case Udjat::Value::Real:
+		case Udjat::Value::Fraction:
+			type = Real;
+			item.get(real);
+			break;
+
+		default:
+			type = Text;
+			text = item.to_string();
+
+		}
+
+		return true;
+
+	}
+
+	bool SQL::Parameter::set(const Abstract::Object &object, const char *name) {
+
+		// Values passed as objects keep the native type.
+		const Udjat::Value *value = dynamic_cast<const Udjat::Value *>(&object);
+		if(value) {
+			return set(*value,name);
+		}
+
+		if(!object.getProperty(name,text)) {
+			return false;
+		}
+
+		// Agents expose their properties as typed values, the agent value is the usual parameter.
+		const Abstract::Agent *agent = dynamic_cast<const Abstract::Agent *>(&object);
+		if(agent) {
+			Udjat::Value properties;
+			agent->getProperties(properties);
+			if(set(properties,name)) {
+				return true;
+			}
+		}
+
+		// Request arguments come from the URL, text is their native type.
+		type = Text;
+		return true;
+
+	}
+
+ }
@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+ /**
+  * @brief Implements the compiled alert plan.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/sql/script.h>
+ #include <udjat/tools/abstract/object.h>
+ #include <private/plan.h>
+ #include <mutex>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Maximum number of value arrays kept for reuse.
+	static const size_t pool_limit = 64;
+
+	SQL::Plan::Plan(const SQL::Script &script) : dburl{script.dbconn()}, mode{script.transaction()}, writes{!script.readonly()} {
+
+		for(const auto &from : script) {
+
+			Statement statement{from.text,from.kind,from.threshold,from.record,{}};
+
+			// Parameter names are quarks, the same name gets the same slot on every statement.
+			for(const char *name : from.parameter_names) {
+
+				size_t slot = 0;
+				while(slot < names.size() && names[slot] != name) {
+					slot++;
+				}
+
+				if(slot == names.size()) {
+					names.push_back(name);
+				}
+
+				statement.slots.push_back(slot);
+
+			}
+
+			statements.push_back(statement);
+
+		}
+
+	}
+
+	SQL::Plan::~Plan() {
+		for(auto slots : pool) {
+			delete slots;
+		}
+	}
+
+	std::shared_ptr<SQL::Plan::Slots> SQL::Plan::acquire() const {
+
+		Slots *slots = nullptr;
+
+		{
+			lock_guard<mutex> lock(guard);
+			if(!pool.empty()) {
+				slots = pool.back();
+				pool.pop_back();
+			}
+		}
+
+		if(!slots) {
+			slots = new Slots(names.size());
+		}
+
+		// The deleter keeps the plan alive until the array returns to its pool.
+		auto plan = shared_from_this();
+		return std::shared_ptr<Slots>(slots,[plan](Slots *slots){
+			plan->recycle(slots);
+		});
+
+	}
+
+	void SQL::Plan::recycle(Slots *slots) const noexcept {
+
+		// Keep the string buffers, just invalidate the values.
+		for(auto &slot : *slots) {
+			slot.valid = false;
+		}
+
+		lock_guard<mutex> lock(guard);
+		if(pool.size() < pool_limit) {
+			pool.push_back(slots);
+		} else {
+			delete slots;
+		}
+
+	}
+
+	void SQL::Plan::set(Slots &slots, const Abstract::Object &object) const {
+		for(size_t slot = 0; slot < names.size(); slot++) {
+			if(!slots[slot].valid) {
+				slots[slot].valid = slots[slot].value.set(object,names[slot]);
+			}
+		}
+	}
+
+ }
@@ -31,6 +31,9 @@
  #include <udjat/tools/logger.h>
  #include <udjat/tools/object.h>
  #include <udjat/tools/quark.h>
+ #include <cstring>
+ #include <cctype>
+ #include <strings.h>
 
 
  #include <udjat/tools/sql/script.h>
@@ -61,6 +64,132 @@
 		}
 
 		this->text = text.strip().as_quark();
+		this->kind = KindFactory(this->text);
+
+	}
+
+	/// @brief Get next SQL token, skip spaces, comments and literals.
+	/// @param ptr Current position, updated to the end of the token.
+	/// @param depth Parenthesis depth, updated.
+	/// @return The token size, 0 on end of text.
+	static size_t next_token(const char * &ptr, int &depth) {
+
+		while(*ptr) {
+
+			if(isspace(*ptr) || *ptr == ',' || *ptr == ';') {
+				ptr++;
+
+			} else if(ptr[0] == '-' && ptr[1] == '-') {
+				while(*ptr && *ptr != '\n') {
+					ptr++;
+				}
+
+			} else if(ptr[0] == '/' && ptr[1] == '*') {
+				const char *end = strstr(ptr+2,"*/");
+				ptr = (end ? end+2 : ptr+strlen(ptr));
+
+			} else if(*ptr == '\'' || *ptr == '"' || *ptr == '`' || *ptr == '[') {
+				char quote = (*ptr == '[' ? ']' : *ptr);
+				ptr++;
+				while(*ptr && *ptr != quote) {
+					ptr++;
+				}
+				if(*ptr) {
+					ptr++;
+				}
+
+			} else if(*ptr == '(') {
+				depth++;
+				ptr++;
+
+			} else if(*ptr == ')') {
+				depth--;
+				ptr++;
+
+			} else if(isalpha(*ptr) || *ptr == '_') {
+				const char *from = ptr;
+				while(isalnum(*ptr) || *ptr == '_') {
+					ptr++;
+				}
+				return ptr - from;
+
+			} else {
+				ptr++;
+
+			}
+
+		}
+
+		return 0;
+
+	}
+
+	uint8_t SQL::Statement::KindFactory(const char *text) {
+
+		static const struct {
+			const char *keyword;
+			uint8_t kind;
+		} verbs[] = {
+			{ "select",		Rows|ReadOnly	},
+			{ "values",		Rows|ReadOnly	},
+			{ "explain",	Rows|ReadOnly	},
+			{ "pragma",		Rows			},
+			{ "insert",		Write			},
+			{ "update",		Write			},
+			{ "delete",		Write			},
+			{ "replace",	Write			},
+			{ "upsert",		Write			},
+			{ "merge",		Write			},
+		};
+
+		const char *ptr = text;
+		int depth = 0;
+		bool cte = false;
+		uint8_t kind = Unknown;
+
+		// Find the main verb, skipping common table expressions.
+		for(size_t length = next_token(ptr,depth); length; length = next_token(ptr,depth)) {
+
+			if(depth) {
+				continue;
+			}
+
+			const char *token = ptr-length;
+
+			if(!cte && length == 4 && !strncasecmp(token,"with",4)) {
+				cte = true;
+				continue;
+			}
+
+			for(const auto &verb : verbs) {
+				if(strlen(verb.keyword) == length && !strncasecmp(token,verb.keyword,length)) {
+					kind = verb.kind;
+					break;
+				}
+			}
+
+			if(kind != Unknown || !cte) {
+				break;
+			}
+
+		}
+
+		if(kind == Unknown) {
+			// DDL, transaction control and unknown statements, just execute.
+			return Write;
+		}
+
+		if(kind & Write) {
+			// Check for 'returning' clause.
+			for(size_t length = next_token(ptr,depth); length; length = next_token(ptr,depth)) {
+				if(!depth && length == 9 && !strncasecmp(ptr-length,"returning",9)) {
+					kind |= Rows;
+					break;
+				}
+			}
+		}
+
+		return kind;
 
 	}
 
@@ -35,6 +35,13 @@
  #include <udjat/tools/sql/script.h>
  #include <udjat/tools/abstract/response.h>
  #include <udjat/tools/application.h>
+ #include <udjat/tools/quark.h>
+ #include <private/executor.h>
+ #include <private/statistics.h>
+
+#ifdef HAVE_SQLITE3
+ #include <private/sqlite.h>
+#endif // HAVE_SQLITE3
 
  using namespace std;
 
@@ -132,9 +139,42 @@
 			throw runtime_error("Invalida database connection string");
 		}
 
+#ifdef HAVE_SQLITE3
+		SQL::Pool::getInstance(dburl).setup(node);
+#endif // HAVE_SQLITE3
+
+		SQL::Executor::getInstance(dburl).setup(node);
+		unsigned int threshold = SQL::Statistics::setup(node);
+
 		// Parse query
 		XML::Node script = node.child(child_name);
 
+		// Get options from script node, if available.
+		{
+			XML::Node options = (script ? script : node);
+
+			const char *name = options.attribute("result-set").as_string();
+			if(name && *name) {
+				rows.name = Quark{name}.c_str();
+			}
+
+			rows.max = options.attribute("max-rows").as_uint(0);
+		}
+
+		// Transaction mode, empty for the engine default.
+		int transaction = -1;
+		{
+			XML::Node options = (script ? script : node);
+
+			const char *name = options.attribute("transaction").as_string(Object::getAttribute(node,"sql","transaction",""));
+			if(name && *name) {
+				transaction = String{name}.select("none","deferred","immediate","exclusive",nullptr);
+				if(transaction < 0) {
+					throw runtime_error(Logger::String{"Invalid transaction '",name,"', expecting none, deferred, immediate or exclusive"});
+				}
+			}
+		}
+
 		if(script) {
 
 			// Scan for SQL scripts
@@ -156,6 +196,30 @@
 
 		}
 
+		for(auto &statement : scripts) {
+			statement.threshold = threshold;
+			if(statement.text && *statement.text) {
+				statement.record = SQL::Statistics::RecordFactory(statement.text,&statement.parameter_names);
+			}
+		}
+
+		if(transaction >= 0) {
+
+			mode = (Transaction) transaction;
+
+		} else {
+
+#if defined(HAVE_SQLITE3)
+			// Autocommit is already one transaction per statement, multi-statement
+			// scripts changing the database should get the write lock up front.
+			mode = (scripts.size() > 1 && !readonly()) ? Immediate : NoTransaction;
+#else
+			// Keep the cppdb behavior: every script inside a transaction.
+			mode = Deferred;
+#endif // HAVE_SQLITE3
+
+		}
+
 	}
 
 	const char * SQL::Script::parse(Udjat::String &query) {
@@ -213,6 +277,15 @@
 	SQL::Script::~Script() {
 	}
 
+	bool SQL::Script::readonly() const noexcept {
+		for(const auto &statement : scripts) {
+			if(!statement.readonly()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	void SQL::Script::exec() const {
 	}
 
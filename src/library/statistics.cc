@@ -0,0 +1,383 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the per statement statistics.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/object.h>
+ #include <private/statistics.h>
+ #include <mutex>
+ #include <memory>
+ #include <string>
+ #include <vector>
+ #include <unordered_map>
+ #include <cstring>
+ #include <strings.h>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	std::atomic<bool> SQL::Statistics::active{false};
+	std::atomic<bool> SQL::Statistics::probing{false};
+
+	/// @brief Statement records, indexed by the interned SQL text.
+	static struct {
+		mutex guard;
+		unordered_map<const char *, unique_ptr<SQL::Statistics::Record>> records;
+	} registry;
+
+	static const char * phase_names[SQL::Statistics::Phases] = { "prepare", "bind", "step", "fetch" };
+
+	/// @brief Slow query log rate limit.
+	static struct {
+		mutex guard;
+
+		/// @brief Maximum entries per minute.
+		unsigned int limit = 10;
+
+		/// @brief Start of the current minute.
+		time_t window = 0;
+
+		/// @brief Entries written on the current minute.
+		unsigned int written = 0;
+
+		/// @brief Entries suppressed since the last one written.
+		unsigned long suppressed = 0;
+	} slowlog;
+
+	void SQL::Statistics::enable() noexcept {
+		probing = true;
+		if(!active.exchange(true)) {
+			Logger::String{"Collecting SQL statement statistics"}.trace("sql");
+		}
+	}
+
+	unsigned int SQL::Statistics::setup(const XML::Node &node) {
+
+		unsigned int milliseconds = Object::getAttribute(node, "sql", "slow-query-threshold", (unsigned int) 0);
+		unsigned int limit = Object::getAttribute(node, "sql", "slow-query-log-limit", slowlog.limit);
+
+		{
+			lock_guard<mutex> lock(slowlog.guard);
+			slowlog.limit = limit;
+		}
+
+		// The threshold is kept by the node statements, probe if any of them can be slow.
+		if(milliseconds) {
+			probing = true;
+		}
+
+		if(enabled()) {
+			return milliseconds;
+		}
+
+		const char *value = Object::getAttribute(node, "sql", "statistics", "no");
+		for(const char *option : { "yes", "true", "on", "1" }) {
+			if(!strcasecmp(value,option)) {
+				enable();
+				break;
+			}
+		}
+
+		return milliseconds;
+
+	}
+
+	void SQL::Statistics::Record::Histogram::add(unsigned long long microseconds) noexcept {
+
+		size_t bucket = 0;
+		while(bucket < (Statistics::Buckets-1) && (1ULL << bucket) <= microseconds) {
+			bucket++;
+		}
+
+		buckets[bucket]++;
+		total += microseconds;
+
+		unsigned long long current = max.load();
+		while(microseconds > current && !max.compare_exchange_weak(current,microseconds));
+
+	}
+
+	unsigned long long SQL::Statistics::Record::Histogram::percentile(double value) const noexcept {
+
+		unsigned long long count = 0;
+		for(const auto &bucket : buckets) {
+			count += bucket.load();
+		}
+
+		if(!count) {
+			return 0;
+		}
+
+		unsigned long long target = (unsigned long long) (count * value);
+		unsigned long long sum = 0;
+		for(size_t ix = 0; ix < Statistics::Buckets; ix++) {
+			sum += buckets[ix].load();
+			if(sum > target) {
+				return 1ULL << ix;
+			}
+		}
+
+		return 1ULL << (Statistics::Buckets-1);
+
+	}
+
+	SQL::Statistics::Record * SQL::Statistics::RecordFactory(const char *text, const std::vector<const char *> *names) {
+
+		lock_guard<mutex> lock(registry.guard);
+		auto &record = registry.records[text];
+		if(!record) {
+			record = make_unique<Record>(text);
+		}
+		if(names && record->names.empty()) {
+			record->names = *names;
+		}
+		return record.get();
+
+	}
+
+	void SQL::Statistics::Probe::begin(Record *record, unsigned int threshold) noexcept {
+
+		limit = ((unsigned long long) threshold) * 1000;
+		this->record = record;
+
+		rows = 0;
+		reached = 0;
+		mark = std::chrono::steady_clock::now();
+
+	}
+
+	void SQL::Statistics::Probe::account(Phase id) noexcept {
+		auto now = std::chrono::steady_clock::now();
+		unsigned long long value = std::chrono::duration_cast<std::chrono::microseconds>(now - mark).count();
+		if(reached & (1 << id)) {
+			elapsed[id] += value;
+		} else {
+			elapsed[id] = value;
+			reached |= (1 << id);
+		}
+		mark = now;
+	}
+
+	void SQL::Statistics::Probe::finish(bool failed) noexcept {
+
+		if(!record) {
+			return;
+		}
+
+		unsigned long long total = 0;
+		for(size_t id = 0; id < Phases; id++) {
+			if(reached & (1 << id)) {
+				total += elapsed[id];
+			}
+		}
+
+		if(active.load(std::memory_order_relaxed)) {
+
+			// One histogram sample per phase and execution.
+			for(size_t id = 0; id < Phases; id++) {
+				if(reached & (1 << id)) {
+					record->phases[id].add(elapsed[id]);
+				}
+			}
+
+			record->executions++;
+			record->rows += rows;
+			if(failed) {
+				record->errors++;
+			}
+
+		}
+
+		if(limit && total >= limit) {
+			slow(total,failed);
+		}
+
+		record = nullptr;
+
+	}
+
+	void SQL::Statistics::Probe::slow(unsigned long long elapsed, bool failed) noexcept {
+
+		unsigned long suppressed = 0;
+
+		// Rate limit.
+		{
+			lock_guard<mutex> lock(slowlog.guard);
+
+			time_t now = time(nullptr);
+			if(now - slowlog.window >= 60) {
+				slowlog.window = now;
+				slowlog.written = 0;
+			}
+
+			if(slowlog.written >= slowlog.limit) {
+				slowlog.suppressed++;
+				return;
+			}
+
+			slowlog.written++;
+			suppressed = slowlog.suppressed;
+			slowlog.suppressed = 0;
+		}
+
+		// Capture the query plan once for each statement.
+		string plan;
+		{
+			bool explain = false;
+			{
+				lock_guard<mutex> lock(registry.guard);
+				explain = !record->explained && explainer;
+				record->explained = record->explained || explainer;
+			}
+
+			if(explain) {
+
+				string value;
+				try {
+					value = explainer->explain(record->text);
+				} catch(const std::exception &e) {
+					value = string{"Unable to explain: "} + e.what();
+				}
+
+				lock_guard<mutex> lock(registry.guard);
+				record->plan = value;
+			}
+
+			lock_guard<mutex> lock(registry.guard);
+			plan = record->plan;
+		}
+
+		string names;
+		for(const char *name : record->names) {
+			if(!names.empty()) {
+				names += ",";
+			}
+			names += name;
+		}
+
+		try {
+
+			Logger::String{
+				"Slow query: elapsed-ms=",((double) elapsed) / 1000,
+				" rows=",rows,
+				" failed=",(failed ? "yes" : "no"),
+				" parameters='",names,"'",
+				" sql='",record->text,"'",
+				" plan='",plan,"'",
+				(suppressed ? " suppressed=" : ""),(suppressed ? std::to_string(suppressed) : "")
+			}.warning("sql");
+
+		} catch(...) {
+			// Logging should never break the query.
+		}
+
+	}
+
+	Udjat::Value & SQL::Statistics::getProperties(Udjat::Value &properties) {
+
+		Udjat::Value &statements = properties["statements"];
+		statements.reset(Udjat::Value::Array);
+
+		lock_guard<mutex> lock(registry.guard);
+
+		for(const auto &it : registry.records) {
+
+			// Scripts register their statements on load, report only the executed ones.
+			const Record &record = *it.second;
+			if(!record.executions.load()) {
+				continue;
+			}
+
+			Udjat::Value &statement = statements.append(Udjat::Value::Object);
+
+			statement["sql"] = record.text;
+			statement["executions"] = (unsigned int) record.executions.load();
+			statement["errors"] = (unsigned int) record.errors.load();
+			statement["rows"] = (unsigned int) record.rows.load();
+
+			for(size_t phase = 0; phase < Phases; phase++) {
+
+				const auto &histogram = record.phases[phase];
+				Udjat::Value &value = statement[phase_names[phase]];
+
+				value["total-ms"] = ((double) histogram.total.load()) / 1000;
+				value["max-us"] = (unsigned int) histogram.max.load();
+				value["p50-us"] = (unsigned int) histogram.percentile(0.50);
+				value["p99-us"] = (unsigned int) histogram.percentile(0.99);
+
+				Udjat::Value &buckets = value["histogram"];
+				buckets.reset(Udjat::Value::Array);
+				for(const auto &bucket : histogram.buckets) {
+					buckets.append(Udjat::Value::Unsigned) = (unsigned int) bucket.load();
+				}
+
+			}
+
+		}
+
+		return properties;
+
+	}
+
+	void SQL::Statistics::get(Udjat::Response::Table &response) {
+
+		std::vector<string> columns{"sql","executions","errors","rows"};
+		for(const char *phase : phase_names) {
+			columns.push_back(string{phase} + "-p50-us");
+			columns.push_back(string{phase} + "-p99-us");
+			columns.push_back(string{phase} + "-max-us");
+		}
+
+		response.start(columns);
+
+		lock_guard<mutex> lock(registry.guard);
+
+		size_t count = 0;
+		for(const auto &it : registry.records) {
+
+			const Record &record = *it.second;
+			if(!record.executions.load()) {
+				continue;
+			}
+			count++;
+
+			response.push_back(record.text);
+			response.push_back(std::to_string(record.executions.load()).c_str());
+			response.push_back(std::to_string(record.errors.load()).c_str());
+			response.push_back(std::to_string(record.rows.load()).c_str());
+
+			for(const auto &histogram : record.phases) {
+				response.push_back(std::to_string(histogram.percentile(0.50)).c_str());
+				response.push_back(std::to_string(histogram.percentile(0.99)).c_str());
+				response.push_back(std::to_string(histogram.max.load()).c_str());
+			}
+
+		}
+
+		response.count(count);
+
+	}
+
+ }
@@ -35,88 +35,472 @@
  #include <udjat/tools/intl.h>
  #include <private/module.h>
  #include <memory>
+ #include <vector>
+ #include <atomic>
+ #include <thread>
+ #include <mutex>
+ #include <algorithm>
+ #include <ctime>
+ #include <future>
+ #include <random>
+ #include <string>
+ #include <cstdio>
+ #include <cstdint>
 
  using namespace std;
 
  namespace Udjat {
 
+	/// @brief Build an identifier unique across processes and hosts sharing the database.
+	static std::string ClaimerFactory() {
+
+		std::random_device device;
+		std::mt19937_64 generator{((uint64_t) device() << 32) ^ device() ^ (uint64_t) time(nullptr)};
+
+		char buffer[20];
+		snprintf(buffer,sizeof(buffer),"%016llx",(unsigned long long) generator());
+		return buffer;
+
+	}
+
 	SQL::URLQueue::URLQueue(const XML::Node &node)
 		:	SQL::Agent<size_t>(node),
 			Udjat::Protocol{Quark(node,"url-queue-name","sql").c_str(),SQL::module_info},
 			ins{node,"insert",true,false},
 			send{node,"send",true,false},
 			after_send{node,"after-send",true,false},
+			claim{node,"claim",true,false},
+			release{node,"release",true,false},
+			lease{Object::getAttribute(node, "urlqueue", "claim-lease", (unsigned int) 300)},
+			claimer{ClaimerFactory()},
 			send_interval{Object::getAttribute(node, "urlqueue", "send-interval", (unsigned int) 60)},
-			send_delay{Object::getAttribute(node, "urlqueue", "send-delay", (unsigned int) 2)} {
+			send_delay{Object::getAttribute(node, "urlqueue", "send-delay", (unsigned int) 2)},
+			senders{Object::getAttribute(node, "urlqueue", "senders", (unsigned int) 1)},
+			reconcile_interval{Object::getAttribute(node, "urlqueue", "reconcile-interval", (unsigned int) 600)} {
+
+		if(!senders) {
+			throw runtime_error("The URL queue requires at least one sender");
+		}
+
+		// Without removing or claiming the sent rows, every pass would send them again.
+		if(!after_send.size() && !claim.size()) {
+			throw runtime_error("The URL queue requires an 'after-send' or a 'claim' script");
+		}
+
+		// Optional group commit for inserts.
+		if(Object::getAttribute(node, "urlqueue", "insert-buffer-size", (unsigned int) 0)) {
+
+			switch(String{Object::getAttribute(node, "urlqueue", "insert-durability", "commit")}.select("commit","enqueue",nullptr)) {
+			case 0:	// Acknowledge after commit.
+				durable = true;
+				break;
+
+			case 1:	// Acknowledge on enqueue.
+				durable = false;
+				break;
+
+			default:
+				throw runtime_error(Logger::String{"Invalid insert-durability '",Object::getAttribute(node, "urlqueue", "insert-durability", ""),"', expecting commit or enqueue"});
+			}
+
+			buffer = make_unique<SQL::Buffer<Insert>>(Protocol::c_str(),[this](std::vector<Insert> &inserts){
+				flush(inserts);
+			});
+			buffer->setup(node,"urlqueue","insert-buffer");
+
+			if(durable && buffer->overflow() == SQL::Buffer<Insert>::Drop) {
+				throw runtime_error("insert-durability='commit' can't be used with insert-buffer-overflow='drop'");
+			}
+
+		}
+
 	}
 
 	SQL::URLQueue::~URLQueue() {
+
+		{
+			lock_guard<mutex> lock(guard);
+			enabled = false;
+		}
+
+		// The senders stop after the rows being sent.
+		wakeup.notify_all();
+		batch.ready.notify_all();
+
+		// Commit the buffered inserts.
+		if(buffer) {
+			buffer->stop();
+		}
+
+		if(dispatcher.joinable()) {
+			dispatcher.join();
+		}
+
+		for(auto &worker : workers) {
+			worker.join();
+		}
+
+	}
+
+	bool SQL::URLQueue::active() {
+		lock_guard<mutex> lock(guard);
+		return enabled;
 	}
 
 	bool SQL::URLQueue::refresh(bool b) {
 
 		debug("----------------- Refreshing url queue");
 
-		// First refresh queue size.
-		bool rc = SQL::Agent<size_t>::refresh(b);
-		size_t qrecs = SQL::Agent<size_t>::get();
+		// The queue depth is tracked in memory, count the table only to reconcile it.
+		bool rc = false;
+		time_t now = time(nullptr);
+		if(!reconciled || (reconciled + reconcile_interval) <= now) {
+
+			// Apply the count as a delta, keeping the inserts and sends running during the query.
+			size_t before = depth.load();
+			rc = SQL::Agent<size_t>::refresh(b);
+			size_t counted = SQL::Agent<size_t>::get();
+
+			size_t current = depth.load();
+			size_t value;
+			do {
+				value = (current + counted > before) ? current + counted - before : 0;
+			} while(!depth.compare_exchange_weak(current,value));
 
-		if(qrecs) {
+			update_depth();
+			reconciled = now;
+			debug("Queue depth reconciled to ",depth.load());
 
-			string url;
+		}
+
+		{
+			// Try a batch even with an empty depth, rows can be queued by other processes or hosts;
+			// the send script is cheap when there's nothing to send.
+			// Send from the background threads, keep the agent refresh short.
+			lock_guard<mutex> lock(guard);
+			if(enabled) {
+
+				requested = true;
+
+				if(!dispatcher.joinable()) {
+					for(size_t count = 1; count < senders; count++) {
+						workers.emplace_back(&URLQueue::work,this);
+					}
+					dispatcher = thread{&URLQueue::dispatch,this};
+				}
+
+			}
+
+		}
+		wakeup.notify_one();
+
+		return rc;
+	}
+
+	void SQL::URLQueue::dispatch() {
+
+		unique_lock<mutex> lock(guard);
+		while(true) {
+
+			wakeup.wait(lock,[this]{
+				return !enabled || requested;
+			});
+
+			if(!enabled) {
+				return;
+			}
+
+			requested = false;
+			lock.unlock();
 
 			try {
+				drain();
+			} catch(const std::exception &e) {
+				SQL::Agent<size_t>::error() << "Error sending queued requests: " << e.what() << endl;
+			}
+
+			lock.lock();
+
+		}
+
+	}
+
+	void SQL::URLQueue::work() {
+
+		unsigned long seen = 0;
+
+		unique_lock<mutex> lock(guard);
+		while(true) {
+
+			batch.ready.wait(lock,[this,&seen]{
+				return !enabled || batch.id != seen;
+			});
+
+			// The dispatcher waits for every worker, take the posted batch even when stopping.
+			if(batch.id == seen) {
+				return;
+			}
+
+			seen = batch.id;
+			lock.unlock();
 
-				bool success = false;
+			send_batch();
+
+			lock.lock();
+			if(!--batch.busy) {
+				batch.finished.notify_all();
+			}
+
+		}
+
+	}
+
+	void SQL::URLQueue::send_batch() {
+
+		const auto &rows = *batch.rows;
+		auto &sent = *batch.sent;
+
+		size_t index;
+		while(active() && (index = batch.next++) < rows.size()) {
+			sent[index] = transmit(*rows[index]);
+		}
+
+	}
+
+	bool SQL::URLQueue::transmit(const Udjat::Value &row) const {
+
+		string url;
+
+		try {
+
+			url = row["url"].to_string();
+			HTTP::Client client(url.c_str());
+
+			switch(HTTP::MethodFactory(row["action"].to_string().c_str())) {
+			case HTTP::Get:
+				{
+					auto response = client.get();
+					SQL::Agent<size_t>::info() << url << endl;
+					Logger::write(Logger::Trace,response);
+				}
+				return true;
+
+			case HTTP::Post:
+				{
+					auto result = client.post(row["payload"].to_string().c_str());
+					Logger::write(Logger::Trace,result);
+				}
+				return true;
 
+			default:
+				SQL::Agent<size_t>::error() << "Unexpected verb '" << row["action"].to_string() << "' sending queued request, ignoring" << endl;
+			}
+
+		} catch(const std::exception &e) {
+
+			SQL::Agent<size_t>::error() << url << ": " << e.what() << endl;
+
+		}
+
+		return false;
+
+	}
+
+	void SQL::URLQueue::update_depth() {
+		SQL::Agent<size_t>::set(depth.load());
+	}
+
+	void SQL::URLQueue::flush(std::vector<Insert> &inserts) {
+
+		std::vector<std::shared_ptr<Udjat::Value>> values;
+		values.reserve(inserts.size());
+		for(const auto &insert : inserts) {
+			values.push_back(insert.value);
+		}
+
+		std::vector<SQL::Script::Result> results;
+		try {
+
+			results = ins.batch(values);
+
+		} catch(...) {
+
+			// The transaction has failed, no row was inserted.
+			auto error = current_exception();
+			for(auto &insert : inserts) {
+				if(insert.done) {
+					insert.done->set_exception(error);
+				}
+			}
+			throw;
+
+		}
+
+		size_t inserted = 0;
+		for(size_t row = 0; row < inserts.size(); row++) {
+
+			auto &done = inserts[row].done;
+
+			if(results[row]) {
+				inserted++;
+				if(done) {
+					done->set_value();
+				}
+			} else if(done) {
+				done->set_exception(make_exception_ptr(runtime_error(results[row].error)));
+			} else {
+				SQL::Agent<size_t>::error() << "Queued request was lost: " << results[row].error << endl;
+			}
+
+		}
+
+		if(inserted) {
+			depth += inserted;
+			update_depth();
+
+			lock_guard<mutex> lock(guard);
+			if(enabled) {
+				sched_update(send_delay);	// Request agent update to send.
+			}
+		}
+
+	}
+
+	Udjat::Value & SQL::URLQueue::getProperties(Udjat::Value &value) const {
+
+		Udjat::Agent<size_t>::getProperties(value);
+
+		if(buffer) {
+			buffer->getProperties(value["insert-buffer"]);
+		}
+
+		return value;
+
+	}
+
+	void SQL::URLQueue::drain() {
+
+		const char *name = send.result_set();
+
+		while(true) {
+
+			if(!active()) {
+				return;
+			}
+
+			// Get the next batch, all rows from the result set or just the first one.
+			std::vector<std::shared_ptr<Udjat::Value>> rows;
+			std::string token;
+			{
 				auto response = Udjat::Value::ObjectFactory();
+
+				if(claim.size()) {
+
+					// Claim rows for this batch, the send script gets the rows claimed by ${claim}.
+					token = claimer + "-" + std::to_string(++claims);
+					(*response)["claim"] = token;
+					(*response)["lease"] = (unsigned int) lease;
+
+					claim.exec(*this,*response);
+
+				}
+
 				send.exec(*this,*response);
-				rc = true;
-
-				url = (*response)["url"].to_string();
-				HTTP::Client client(url.c_str());
-
-				switch(HTTP::MethodFactory((*response)["action"].to_string().c_str())) {
-				case HTTP::Get:
-					{
-						auto response = client.get();
-						SQL::Agent<size_t>::info() << url << endl;
-						Logger::write(Logger::Trace,response);
-						success = true;
-					}
-					break;
 
-				case HTTP::Post:
-					{
-						auto result = client.post((*response)["payload"].to_string().c_str());
-						Logger::write(Logger::Trace,result);
-						success = true;
-					}
-					break;
+				if(name && *name) {
+					(*response)[name].for_each([&rows,&token](const char *, const Udjat::Value &value){
+						auto row = Udjat::Value::ObjectFactory();
+						row->set(value);
+						if(!token.empty()) {
+							(*row)["claim"] = token;
+						}
+						rows.push_back(row);
+						return false;
+					});
+				} else if(!(*response)["url"].to_string().empty()) {
+					rows.push_back(response);
+				}
+			}
 
-				default:
-					SQL::Agent<size_t>::error() << "Unexpected verb '" << (*response)["action"].to_string() << "' sending queued request, ignoring" << endl;
-					success = false;
+			if(rows.empty()) {
+				debug("URL queue is empty");
+				return;
+			}
+
+			// Send rows, up to 'senders' remote calls at once.
+			std::vector<char> sent(rows.size(),0);
+			{
+				{
+					lock_guard<mutex> lock(guard);
+					batch.rows = &rows;
+					batch.sent = &sent;
+					batch.next = 0;
+					batch.busy = workers.size();
+					batch.id++;
 				}
+				batch.ready.notify_all();
+
+				// The dispatcher thread is one of the senders.
+				send_batch();
+
+				unique_lock<mutex> lock(guard);
+				batch.finished.wait(lock,[this]{
+					return !batch.busy;
+				});
+				batch.rows = nullptr;
+				batch.sent = nullptr;
+			}
 
-				if(success) {
-					after_send.exec(*this,*response);
-					SQL::Agent<size_t>::set(--qrecs);
-					if(send_interval) {
-						debug("Will send next in ",send_interval," second(s)");
-						sched_update(send_interval);
+			// Remove the sent rows, one transaction for the whole batch.
+			std::vector<std::shared_ptr<Udjat::Value>> done;
+			for(size_t row = 0; row < rows.size(); row++) {
+				if(sent[row]) {
+					done.push_back(rows[row]);
+				}
+			}
+
+			size_t removed = 0;
+			if(!done.empty() && after_send.size()) {
+
+				for(const auto &result : after_send.batch(*this,done)) {
+					if(result) {
+						removed++;
 					}
 				}
 
-			} catch(const std::exception &e) {
+				size_t current = depth.load();
+				while(!depth.compare_exchange_weak(current, current > removed ? current - removed : 0));
+				update_depth();
 
-				SQL::Agent<size_t>::error() << url << ": " << e.what() << endl;
+			}
+
+			// Stop on failed sends and on sent rows still on the queue, the next pass would select them again.
+			if(done.size() < rows.size() || removed < done.size()) {
+
+				// Failed rows are still on the queue, release them for other senders.
+				if(release.size() && done.size() < rows.size()) {
+
+					std::vector<std::shared_ptr<Udjat::Value>> failed;
+					for(size_t row = 0; row < rows.size(); row++) {
+						if(!sent[row]) {
+							failed.push_back(rows[row]);
+						}
+					}
+
+					release.batch(*this,failed);
 
+				}
+
+				// Retry later.
+				if(send_interval && active()) {
+					debug("Will retry in ",send_interval," second(s)");
+					sched_update(send_interval);
+				}
+				return;
 			}
 
 		}
 
-		return rc;
 	}
 
 	std::shared_ptr<Protocol::Worker> SQL::URLQueue::WorkerFactory() const {
@@ -141,16 +525,42 @@
 				debug("----------------------------> Inserting alert on queue");
 				(*value)["url"] = url().c_str(),
 				(*value)["action"] = std::to_string(method()),
-				(*value)["payload"] = payload(),
+				(*value)["payload"] = payload();
+
+				if(agent->buffer) {
+
+					// Group commit, wait for it only when acknowledging after commit.
+					URLQueue *obj = const_cast<URLQueue *>(this->agent);
+
+					shared_ptr<promise<void>> done;
+					future<void> committed;
+					if(obj->durable) {
+						done = make_shared<promise<void>>();
+						committed = done->get_future();
+					}
+
+					if(!obj->buffer->push(Insert{value,done})) {
+						throw runtime_error("URL queue is full, request dropped");
+					}
+
+					if(done) {
+						committed.get();
+					}
+
+					progress(1,1);
+					return "";
+
+				}
 
 				agent->ins.exec(value);
 
 				{
 					URLQueue *obj = const_cast<URLQueue *>(this->agent);
 					if(obj) {
-						obj->SQL::Agent<size_t>::set(obj->SQL::Agent<size_t>::get()+1);
-						debug("QUEUE set to ",obj->SQL::Agent<size_t>::get());
-						obj->sched_update(1);	// Request agent update.
+						obj->depth++;
+						obj->update_depth();
+						debug("QUEUE set to ",obj->depth.load());
+						obj->sched_update(obj->send_delay);	// Request agent update to send.
 					} else {
 						Logger::String{"Unable to request agent update"}.warning("urlqueue");
 					}
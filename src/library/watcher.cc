@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the database change watcher.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/sql/script.h>
+ #include <udjat/tools/string.h>
+ #include <udjat/tools/logger.h>
+ #include <private/watcher.h>
+ #include <mutex>
+ #include <list>
+ #include <unordered_map>
+ #include <strings.h>
+
+#ifdef HAVE_SQLITE3
+ #include <private/sqlite.h>
+#endif // HAVE_SQLITE3
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Active subscriptions, indexed by the interned connection string.
+	static struct {
+		mutex guard;
+		unordered_map<const char *, list<const SQL::Subscription *>> subscriptions;
+	} registry;
+
+	SQL::Subscription::Subscription(const char *d, const char *names, const std::function<void()> &m, bool e) : dburl{d}, method{m}, external{e} {
+
+		for(auto &name : String{names}.split(",")) {
+			name.strip();
+			if(name.empty()) {
+				continue;
+			}
+			if(name == "*") {
+				// Any change on the database.
+				tables.clear();
+				break;
+			}
+			tables.push_back(name.c_str());
+		}
+
+		lock_guard<mutex> lock(registry.guard);
+		registry.subscriptions[dburl].push_back(this);
+
+	}
+
+	SQL::Subscription::~Subscription() {
+		// Waits for a running notification, the method is never called after this.
+		lock_guard<mutex> lock(registry.guard);
+		registry.subscriptions[dburl].remove(this);
+	}
+
+	bool SQL::Subscription::depends(const std::vector<std::string> &changed) const noexcept {
+
+		if(tables.empty() || changed.empty()) {
+			return true;
+		}
+
+		for(const auto &table : tables) {
+			for(const auto &name : changed) {
+				if(!strcasecmp(table.c_str(),name.c_str())) {
+					return true;
+				}
+			}
+		}
+
+		return false;
+
+	}
+
+	/// @brief Call the subscriptions on database accepted by filter.
+	static void notify(const char *dburl, const std::function<bool(const SQL::Subscription &subscription)> &filter) {
+
+		lock_guard<mutex> lock(registry.guard);
+
+		auto it = registry.subscriptions.find(dburl);
+		if(it == registry.subscriptions.end()) {
+			return;
+		}
+
+		for(auto subscription : it->second) {
+			if(filter(*subscription)) {
+				try {
+					subscription->changed();
+				} catch(const std::exception &e) {
+					Logger::String{"Change notification has failed: ",e.what()}.error("sql");
+				}
+			}
+		}
+
+	}
+
+	void SQL::Watcher::changed(const char *dburl, const std::vector<std::string> &tables) {
+		notify(dburl,[&tables](const SQL::Subscription &subscription){
+			return subscription.depends(tables);
+		});
+	}
+
+	void SQL::Watcher::external(const char *dburl) {
+		notify(dburl,[](const SQL::Subscription &subscription){
+			return subscription.accepts_external();
+		});
+	}
+
+	std::shared_ptr<SQL::Subscription> SQL::Script::watch(const char *tables, const std::function<void()> &changed, bool external) const {
+
+#ifdef HAVE_SQLITE3
+		// Writes from other processes are detected by polling the database.
+		if(external) {
+			SQL::Pool::getInstance(dburl).watch();
+		}
+#endif // HAVE_SQLITE3
+
+		return make_shared<SQL::Subscription>(dburl,tables,changed,external);
+
+	}
+
+ }
@@ -31,6 +31,15 @@
  #include <udjat/alert/sql.h>
  #include <private/urlqueue.h>
  #include <private/module.h>
+ #include <private/router.h>
+ #include <private/executor.h>
+ #include <private/statistics.h>
+ #include <private/writer.h>
+
+#ifdef HAVE_SQLITE3
+ #include <private/maintenance.h>
+#endif // HAVE_SQLITE3
+ #include <list>
 
  using namespace Udjat;
  using namespace std;
@@ -41,13 +50,59 @@
 	class Module : public Udjat::Module, private Udjat::Worker, private Udjat::Factory {
 	private:
 
-		std::vector<SQL::ApiCall> queries;
+		/// @brief The api-calls, on a list to keep them in place for the router.
+		std::list<SQL::ApiCall> queries;
+
+		/// @brief Index of api-calls by path.
+		SQL::Router<SQL::ApiCall> router;
+
+		/// @brief Find the api-call for request.
+		inline const SQL::ApiCall * find(const Request &request) const {
+			return router.find(request.path(),[&request](const SQL::ApiCall &query){
+				return query == request;
+			});
+		}
+
+		/// @brief Find the api-call for request and remove its path from the request.
+		/// @return The first api-call whose path could be removed from the request, nullptr if none.
+		inline const SQL::ApiCall * pop(Request &request) const {
+			return router.find(request.path(),[&request](const SQL::ApiCall &query){
+				return query == request && request.pop(query.path());
+			});
+		}
+
+		void push_back(const XML::Node &node) {
+			queries.emplace_back(node);
+			router.push_back(queries.back());
+		}
 
 	public:
 		Module() : Udjat::Module("cppdb",SQL::module_info), Udjat::Worker("sql",SQL::module_info), Udjat::Factory("sql",SQL::module_info) {
 		};
 
 		~Module() {
+			// Run pending asynchronous scripts and alerts before unloading.
+			SQL::Writer::shutdown();
+			SQL::Executor::shutdown();
+			SQL::shutdown();
+		}
+
+		Udjat::Value & getProperties(Udjat::Value &properties) const override {
+
+			Udjat::Module::getProperties(properties);
+
+			Udjat::Value &executors = properties["executors"];
+			SQL::Executor::for_each([&executors](const SQL::Executor &executor){
+				executor.getProperties(executors.append(Udjat::Value::Object));
+			});
+
+			SQL::Writer::getProperties(properties["alert-writers"]);
+
+			if(SQL::Statistics::enabled()) {
+				SQL::Statistics::getProperties(properties);
+			}
+
+			return SQL::getProperties(properties);
 		}
 
 		void trace_paths(const char *url_prefix) const noexcept override {
@@ -59,12 +114,10 @@
 		// Udjat::Worker
 		ResponseType probe(const Request &request) const noexcept override {
 
-			for(const auto &query : queries) {
-				debug("query='",query.path(),"' request='",request.path(),"'");
-				if(query == request) {
-					debug("Accepting '",query.path(),"' as ",((Worker::ResponseType) query));
-					return (Worker::ResponseType) query;
-				}
+			const SQL::ApiCall *query = find(request);
+			if(query) {
+				debug("Accepting '",query->path(),"' as ",((Worker::ResponseType) *query));
+				return (Worker::ResponseType) *query;
 			}
 
 			debug("Rejecting '",request.path(),"'");
@@ -73,11 +126,10 @@
 
 		bool work(Request &request, Response::Table &response) const override {
 
-			for(const auto &query : queries) {
-				if(query == request && request.pop(query.path())) {
-					debug(__FUNCTION__,"('",request.path(),"')");
-					return query.exec(request,response);
-				}
+			const SQL::ApiCall *query = pop(request);
+			if(query) {
+				debug(__FUNCTION__,"('",request.path(),"')");
+				return query->exec(request,response);
 			}
 
 			return false;
@@ -86,11 +138,10 @@
 
 		bool work(Request &request, Response::Value &response) const override {
 
-			for(const auto &query : queries) {
-				if(query == request && request.pop(query.path())) {
-					debug(__FUNCTION__,"('",request.path(),"')");
-					return query.exec(request,response);
-				}
+			const SQL::ApiCall *query = pop(request);
+			if(query) {
+				debug(__FUNCTION__,"('",request.path(),"')");
+				return query->exec(request,response);
 			}
 
 			return false;
@@ -111,7 +162,7 @@
 
 			case 2: // api-call
 				debug("API-Call");
-				queries.emplace_back(node);
+				push_back(node);
 				break;
 
 			default:
@@ -137,7 +188,7 @@
 			case 2: // Query
 			case 3: // api-call
 				debug("API-Call/Query");
-				queries.emplace_back(node);
+				push_back(node);
 				break;
 
 			default:
@@ -157,6 +208,14 @@
 				return make_shared<SQL::URLQueue>(node);
 			}
 
+			if(node.attribute("maintenance").as_bool(false)) {
+#ifdef HAVE_SQLITE3
+				return make_shared<SQL::Maintenance>(node);
+#else
+				throw runtime_error("Maintenance agents are only available on the sqlite engine");
+#endif // HAVE_SQLITE3
+			}
+
 			//
 			// Try standard agents.
 			//